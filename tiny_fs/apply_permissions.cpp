@@ -0,0 +1,154 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "apply_permissions.hpp"
+#include "find.hpp"
+#include "instrumentation.hpp"
+#include <atomic>
+#include <memory>
+
+#ifdef _WIN32
+#include <AclAPI.h>
+#include <sddl.h>
+#endif // _WIN32
+
+namespace tinydircpp {
+    namespace fs {
+        namespace details
+        {
+            local_pointer parse_sid( std::wstring const & sid )
+            {
+                PSID parsed = nullptr;
+                if ( ConvertStringSidToSidW( sid.c_str(), &parsed ) == 0 ) {
+                    throw fs::filesystem_error{ get_windows_error( GetLastError() ),
+                        std::make_error_code( std::errc::invalid_argument ) };
+                }
+                return local_pointer{ parsed };
+            }
+
+            // true when the owner had to be changed
+            bool change_owner( path const & p, PSID owner )
+            {
+                smart_handle handle{ TINYDIR_SYSCALL( create_file, CreateFileW( p.c_str(), READ_CONTROL | WRITE_OWNER,
+                    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                    FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OPEN_REPARSE_POINT, nullptr ) ) };
+                if ( !handle ) {
+                    FSTHROW_MANUAL( fs::filesystem_error_codes::handle_not_opened, p );
+                }
+                PSID current = nullptr;
+                PSECURITY_DESCRIPTOR descriptor = nullptr;
+                DWORD result = TINYDIR_SYSCALL( security_info, GetSecurityInfo( handle, SE_FILE_OBJECT,
+                    OWNER_SECURITY_INFORMATION, &current, nullptr, nullptr, nullptr, &descriptor ) );
+                if ( result != ERROR_SUCCESS ) {
+                    SetLastError( result );
+                    FSTHROW_MANUAL( fs::filesystem_error_codes::unknown_io_error, p );
+                }
+                local_pointer const descriptor_guard{ descriptor };
+                if ( EqualSid( current, owner ) ) return false;
+                result = TINYDIR_SYSCALL( security_info, SetSecurityInfo( handle, SE_FILE_OBJECT,
+                    OWNER_SECURITY_INFORMATION, owner, nullptr, nullptr, nullptr ) );
+                if ( result != ERROR_SUCCESS ) {
+                    SetLastError( result );
+                    FSTHROW_MANUAL( fs::filesystem_error_codes::unknown_io_error, p );
+                }
+                return true;
+            }
+        }
+
+        apply_result apply_permissions( path const & root, permission_changes const & changes )
+        {
+            TINYDIR_TRACE_API( apply_permissions );
+            if ( changes.set_permissions && ( static_cast< int >( changes.how )
+                & static_cast< int >( permissions_status::follow_symlinks ) ) != 0 ) {
+                throw fs::filesystem_error{ "links are not followed while applying permissions", root,
+                    std::make_error_code( std::errc::invalid_argument ) };
+            }
+            details::local_pointer const owner = changes.owner.empty() ? details::local_pointer{}
+                : details::parse_sid( changes.owner );
+            std::atomic<std::uintmax_t> changed{ 0 }, unchanged{ 0 }, failed{ 0 };
+            auto const apply = [&]( path const & p, DWORD file_attrib ) {
+                try {
+                    bool altered = false;
+                    if ( changes.set_permissions ) {
+                        DWORD const wanted = details::attributes_with_perms( file_attrib, changes.permissions,
+                            changes.how );
+                        if ( wanted != file_attrib ) {
+                            if ( TINYDIR_SYSCALL( set_file_attributes, SetFileAttributesW( p.c_str(),
+                                wanted == 0 ? FILE_ATTRIBUTE_NORMAL : wanted ) ) == 0 ) {
+                                FSTHROW_MANUAL( fs::filesystem_error_codes::unknown_io_error, p );
+                            }
+                            altered = true;
+                        }
+                    }
+                    if ( owner ) altered = details::change_owner( p, owner.get() ) || altered;
+                    ++( altered ? changed : unchanged );
+                } catch ( fs::filesystem_error const & ) {
+                    ++failed;
+                }
+            };
+
+            if ( changes.include_root ) {
+                DWORD const file_attrib = TINYDIR_SYSCALL( get_file_attributes, GetFileAttributesW( root.c_str() ) );
+                if ( file_attrib == INVALID_FILE_ATTRIBUTES ) {
+                    FSTHROW_MANUAL( fs::filesystem_error_codes::handle_not_opened, root );
+                }
+                apply( root, file_attrib );
+            }
+            // the walker is only borrowed for its listing, nothing is ever accepted
+            find_options walk{};
+            walk.thread_count = changes.thread_count;
+            fs::find( root, find_predicate{ find_cost::file_information, [&apply]( find_candidate const & c ) {
+                apply( c.path(), c.attributes() );
+                return false;
+            } }, walk );
+
+            apply_result result{};
+            result.changed = changed;
+            result.unchanged = unchanged;
+            result.failed = failed;
+            return result;
+        }
+
+        apply_result apply_permissions( path const & root, permission_changes const & changes,
+            std::error_code & ec ) noexcept
+        {
+            FSERROR_TRY_CATCH( return apply_permissions( root, changes ), ec );
+            return apply_result{};
+        }
+
+        void set_owner( path const & p, std::wstring const & owner_sid )
+        {
+            TINYDIR_TRACE_API( permissions );
+            details::change_owner( p, details::parse_sid( owner_sid ).get() );
+        }
+
+        void set_owner( path const & p, std::wstring const & owner_sid, std::error_code & ec ) noexcept
+        {
+            FSERROR_TRY_CATCH( set_owner( p, owner_sid ), ec );
+        }
+    }
+}
+
+#undef FSERROR_TRY_CATCH
@@ -0,0 +1,69 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef TINYDIRCPP_APPLY_PERMISSIONS_HPP
+#define TINYDIRCPP_APPLY_PERMISSIONS_HPP
+
+#include <cstdint>
+#include <string>
+
+#include "tinydircpp.hpp"
+
+namespace tinydircpp {
+    namespace fs
+    {
+        struct permission_changes {
+            // the permissions to give every entry, left alone unless set_permissions is
+            bool set_permissions = false;
+            perms permissions = perms::none;
+            // the walk never follows links, so permissions_status::follow_symlinks is rejected as invalid_argument
+            permissions_status how = permissions_status::replace_bits;
+            // the new owner as a string SID such as "S-1-5-32-544", left alone when empty. Giving files away to
+            // another account takes SeRestorePrivilege, the way chown takes root
+            std::wstring owner{};
+            std::size_t thread_count = 0; // 0 for one thread per core
+            bool include_root = true;
+        };
+
+        struct apply_result {
+            std::uintmax_t changed = 0;
+            std::uintmax_t unchanged = 0;
+            std::uintmax_t failed = 0; // entries that could not be changed, the walk goes on past them
+        };
+
+        // chmod -R and chown -R in one walk over the parallel fs::find walker. Permissions are checked against the
+        // attributes that came with the listing, so entries that already have them cost no system call at all;
+        // an owner is read before it is written, as rewriting a security descriptor is far dearer than reading it.
+        // Symlinks are changed themselves, never followed.
+        apply_result apply_permissions( path const & root, permission_changes const & changes );
+        apply_result apply_permissions( path const & root, permission_changes const & changes,
+            std::error_code & ec ) noexcept;
+
+        // lchown(): hands p over to the account with the string SID owner_sid
+        void set_owner( path const & p, std::wstring const & owner_sid );
+        void set_owner( path const & p, std::wstring const & owner_sid, std::error_code & ec ) noexcept;
+    }
+}
+#endif
@@ -0,0 +1,108 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "arena.hpp"
+#include "instrumentation.hpp"
+#include <algorithm>
+#include <new>
+
+namespace tinydircpp {
+    namespace fs {
+        monotonic_arena::monotonic_arena( std::size_t initial_block_size ) noexcept :
+            next_block_size_{ ( std::max )( initial_block_size, sizeof( block ) * 2 ) }
+        {
+        }
+
+        monotonic_arena::~monotonic_arena()
+        {
+            while ( head_ != nullptr ) {
+                block * const next = head_->next;
+                ::operator delete( head_ );
+                head_ = next;
+            }
+        }
+
+        void * monotonic_arena::allocate( std::size_t bytes, std::size_t alignment )
+        {
+            std::size_t const misalignment = reinterpret_cast< std::uintptr_t >( cursor_ ) % alignment;
+            std::size_t const padding = misalignment == 0 ? 0 : alignment - misalignment;
+            if ( cursor_ == nullptr || static_cast< std::size_t >( end_ - cursor_ ) < padding + bytes ) {
+                // blocks double in size, a big scan ends up with a few large blocks rather than many small ones
+                std::size_t const size = ( std::max )( next_block_size_, sizeof( block ) + alignment + bytes );
+                block * const new_block = static_cast< block * >( ::operator new( size ) );
+                new_block->next = head_;
+                new_block->size = size;
+                head_ = new_block;
+                cursor_ = reinterpret_cast< char * >( new_block + 1 );
+                end_ = reinterpret_cast< char * >( new_block ) + size;
+                reserved_ += size;
+                next_block_size_ = size * 2;
+                return allocate( bytes, alignment );
+            }
+            void * const result = cursor_ + padding;
+            cursor_ += padding + bytes;
+            return result;
+        }
+
+        void monotonic_arena::release() noexcept
+        {
+            if ( head_ == nullptr ) return;
+            // the newest block is the largest one
+            while ( head_->next != nullptr ) {
+                block * const next = head_->next->next;
+                ::operator delete( head_->next );
+                head_->next = next;
+            }
+            cursor_ = reinterpret_cast< char * >( head_ + 1 );
+            end_ = reinterpret_cast< char * >( head_ ) + head_->size;
+            reserved_ = head_->size;
+        }
+
+        namespace details
+        {
+            void visit_directory( path const & p, find_data_visitor visit, void * context )
+            {
+                TINYDIR_TRACE_API( list_directory );
+                WIN32_FIND_DATAW find_data{};
+                path const pattern{ p / path{ "\\*" } };
+                HANDLE search_handle = TINYDIR_SYSCALL( find_first_file, FindFirstFileExW( pattern.c_str(),
+                    FindExInfoBasic, &find_data, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH ) );
+                if ( search_handle == INVALID_HANDLE_VALUE ) {
+                    FSTHROW_MANUAL( fs::filesystem_error_codes::handle_not_opened, p );
+                }
+                // closes the search however visit leaves
+                std::unique_ptr<void, BOOL( WINAPI * )( HANDLE )> const search_guard{ search_handle, FindClose };
+                do {
+                    if ( !is_dot_or_dotdot( find_data.cFileName ) ) visit( context, find_data );
+                } while ( TINYDIR_SYSCALL( find_next_file, FindNextFileW( search_handle, &find_data ) ) != 0 );
+                if ( GetLastError() != ERROR_NO_MORE_FILES ) {
+                    FSTHROW_MANUAL( fs::filesystem_error_codes::unknown_io_error, p );
+                }
+            }
+        }
+    }
+}
+
+#undef FSERROR_TRY_CATCH
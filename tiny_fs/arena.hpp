@@ -0,0 +1,209 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef TINYDIRCPP_ARENA_HPP
+#define TINYDIRCPP_ARENA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tinydircpp.hpp"
+
+namespace tinydircpp {
+    namespace fs
+    {
+        // hands out memory from a few large blocks and never gives any of it back on its own; release() frees
+        // everything at once. Not thread safe, give every walker thread an arena of its own.
+        class monotonic_arena {
+        public:
+            explicit monotonic_arena( std::size_t initial_block_size = 64 * 1024 ) noexcept;
+            ~monotonic_arena();
+            monotonic_arena( monotonic_arena const & ) = delete;
+            monotonic_arena& operator=( monotonic_arena const & ) = delete;
+
+            void * allocate( std::size_t bytes, std::size_t alignment );
+            // everything allocated so far is gone; the largest block is kept for the next round
+            void release() noexcept;
+            std::size_t bytes_reserved() const noexcept { return reserved_; }
+        private:
+            struct block {
+                block * next;
+                std::size_t size;
+            };
+
+            block * head_ = nullptr;
+            char * cursor_ = nullptr;
+            char * end_ = nullptr;
+            std::size_t next_block_size_;
+            std::size_t reserved_ = 0;
+        };
+
+        template<typename T>
+        class arena_allocator {
+        public:
+            using value_type = T;
+
+            arena_allocator( monotonic_arena & arena ) noexcept : arena_{ &arena } {}
+            template<typename U>
+            arena_allocator( arena_allocator<U> const & other ) noexcept : arena_{ other.arena() } {}
+
+            T * allocate( std::size_t n )
+            {
+                return static_cast< T * >( arena_->allocate( n * sizeof( T ), alignof( T ) ) );
+            }
+            void deallocate( T *, std::size_t ) noexcept {} // the arena frees it all in one go
+            monotonic_arena * arena() const noexcept { return arena_; }
+        private:
+            monotonic_arena * arena_;
+        };
+
+        template<typename T, typename U>
+        bool operator==( arena_allocator<T> const & a, arena_allocator<U> const & b ) noexcept
+        {
+            return a.arena() == b.arena();
+        }
+
+        template<typename T, typename U>
+        bool operator!=( arena_allocator<T> const & a, arena_allocator<U> const & b ) noexcept
+        {
+            return !( a == b );
+        }
+
+        // a path whose name is kept with the given allocator. It does just enough for walking a directory tree,
+        // to_path() turns it into a regular path for the rest of the library.
+        template<typename Allocator = std::allocator<wchar_t>>
+        class basic_path {
+        public:
+            using value_type = wchar_t;
+            using allocator_type = Allocator;
+            using string_type = std::basic_string<wchar_t, std::char_traits<wchar_t>, Allocator>;
+
+            explicit basic_path( Allocator const & allocator = Allocator() ) : pathname_( allocator ) {}
+            basic_path( wchar_t const * name, std::size_t size, Allocator const & allocator = Allocator() ) :
+                pathname_( name, size, allocator )
+            {
+            }
+            basic_path( path const & p, Allocator const & allocator = Allocator() ) :
+                pathname_( p.c_str(), p.native().size(), allocator )
+            {
+            }
+
+            // the result is sized once, and lives with the same allocator as this path
+            basic_path append( wchar_t const * name, std::size_t size ) const
+            {
+                basic_path result{ pathname_.get_allocator() };
+                bool const separator = !pathname_.empty() && pathname_.back() != L'\\' && pathname_.back() != L'/';
+                result.pathname_.reserve( pathname_.size() + separator + size );
+                result.pathname_.append( pathname_ );
+                if ( separator ) result.pathname_.push_back( L'\\' );
+                result.pathname_.append( name, size );
+                return result;
+            }
+
+            wchar_t const * filename() const noexcept
+            {
+                auto const separator = pathname_.find_last_of( L"\\/" );
+                return pathname_.c_str() + ( separator == string_type::npos ? 0 : separator + 1 );
+            }
+
+            path to_path() const { return path{ std::wstring( pathname_.c_str(), pathname_.size() ) }; }
+            string_type const & native() const noexcept { return pathname_; }
+            wchar_t const * c_str() const noexcept { return pathname_.c_str(); }
+            std::size_t size() const noexcept { return pathname_.size(); }
+            bool empty() const noexcept { return pathname_.empty(); }
+            allocator_type get_allocator() const { return pathname_.get_allocator(); }
+        private:
+            string_type pathname_;
+        };
+
+        template<typename Allocator = std::allocator<wchar_t>>
+        class basic_directory_entry {
+        public:
+            using path_type = basic_path<Allocator>;
+
+            basic_directory_entry( path_type && p, WIN32_FIND_DATAW const & find_data ) noexcept :
+                path_( std::move( p ) ),
+                status_( details::status_from_attributes( find_data.dwFileAttributes, find_data.dwReserved0 ) ),
+                file_size_( ( static_cast< std::uint64_t >( find_data.nFileSizeHigh ) << 32 )
+                    | find_data.nFileSizeLow ),
+                write_time_( find_data.ftLastWriteTime )
+            {
+            }
+
+            path_type const & path() const noexcept { return path_; }
+            file_status status() const noexcept { return status_; }
+            std::uintmax_t file_size() const noexcept { return file_size_; }
+            file_time_type last_write_time() const { return details::Win32FiletimeToChronoTime( write_time_ ); }
+        private:
+            path_type path_;
+            file_status status_;
+            std::uint64_t file_size_;
+            FILETIME write_time_;
+        };
+
+        using arena_path = basic_path<arena_allocator<wchar_t>>;
+        using arena_directory_entry = basic_directory_entry<arena_allocator<wchar_t>>;
+
+        namespace details
+        {
+            using find_data_visitor = void( *)( void * context, WIN32_FIND_DATAW const & find_data );
+            // calls visit for every entry of p but "." and ".."
+            void visit_directory( path const & p, find_data_visitor visit, void * context );
+        }
+
+        template<typename Allocator>
+        using directory_listing = std::vector<basic_directory_entry<Allocator>,
+            typename std::allocator_traits<Allocator>::template rebind_alloc<basic_directory_entry<Allocator>>>;
+
+        // the entries of p with every path and the listing itself taken from allocator. With an
+        // arena_allocator a whole tree walk costs a handful of large allocations, freed by the arena's release().
+        template<typename Allocator>
+        directory_listing<Allocator> list_directory( path const & p, Allocator const & allocator )
+        {
+            struct context_type {
+                directory_listing<Allocator> entries;
+                basic_path<Allocator> directory;
+            } context{ directory_listing<Allocator>( allocator ), basic_path<Allocator>( p, allocator ) };
+            details::visit_directory( p, []( void * c, WIN32_FIND_DATAW const & find_data ) {
+                auto & ctx = *static_cast< context_type * >( c );
+                ctx.entries.emplace_back( ctx.directory.append( find_data.cFileName,
+                    std::char_traits<wchar_t>::length( find_data.cFileName ) ), find_data );
+            }, &context );
+            return std::move( context.entries );
+        }
+
+        template<typename Allocator>
+        directory_listing<Allocator> list_directory( path const & p, Allocator const & allocator,
+            std::error_code & ec ) noexcept
+        {
+            FSERROR_TRY_CATCH( return list_directory( p, allocator ), ec );
+            return directory_listing<Allocator>( allocator );
+        }
+    }
+}
+#endif
@@ -0,0 +1,234 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "async.hpp"
+#include "instrumentation.hpp"
+#include <algorithm>
+
+namespace tinydircpp {
+    namespace fs {
+        namespace details
+        {
+            constexpr ULONG_PTR stop_key = 1;
+
+            // everything that comes out of the completion port is one of these
+            struct io_operation : OVERLAPPED {
+                io_operation() : OVERLAPPED{} {}
+                virtual ~io_operation() = default;
+                virtual void complete( DWORD bytes, DWORD error ) noexcept = 0;
+            };
+
+            struct posted_work final : io_operation {
+                explicit posted_work( std::function<void()> && w ) : work( std::move( w ) ) {}
+                void complete( DWORD, DWORD ) noexcept override
+                {
+                    work();
+                    delete this;
+                }
+                std::function<void()> work;
+            };
+
+            // reads a file in chunks, each chunk is started from the completion of the one before it
+            class file_read final : public io_operation {
+            public:
+                file_read( HANDLE file, std::size_t size, read_file_handler && handler ) :
+                    file_{ file }, contents_( size, '\0' ), handler_( std::move( handler ) )
+                {
+                }
+
+                // 0 when the read is on its way, the error that stopped it otherwise
+                DWORD start() noexcept
+                {
+                    static constexpr std::size_t chunk_size = 1024 * 1024;
+                    DWORD const chunk = static_cast< DWORD >( ( std::min )( chunk_size, contents_.size() - offset_ ) );
+                    ULARGE_INTEGER position{};
+                    position.QuadPart = offset_;
+                    Offset = position.LowPart;
+                    OffsetHigh = position.HighPart;
+                    if ( TINYDIR_SYSCALL( read_file, ReadFile( file_, &contents_[ offset_ ], chunk, nullptr,
+                        this ) ) == 0 && GetLastError() != ERROR_IO_PENDING ) {
+                        return GetLastError();
+                    }
+                    return 0;
+                }
+
+                void complete( DWORD bytes, DWORD error ) noexcept override
+                {
+                    if ( error != 0 || bytes == 0 ) return finish( error == 0 ? ERROR_HANDLE_EOF : error );
+                    offset_ += bytes;
+                    if ( offset_ == contents_.size() ) return finish( 0 );
+                    error = start();
+                    if ( error != 0 ) finish( error );
+                }
+
+                // ERROR_HANDLE_EOF only means the file got shorter while it was read, whether ReadFile said so
+                // right away or through the completion port
+                void finish( DWORD error ) noexcept
+                {
+                    if ( error == ERROR_HANDLE_EOF ) {
+                        contents_.resize( offset_ );
+                        error = 0;
+                    }
+                    std::error_code ec{};
+                    if ( error != 0 ) ec = std::error_code( fs::filesystem_error_codes::unknown_io_error );
+                    handler_( ec, error == 0 ? std::move( contents_ ) : std::string{} );
+                    delete this;
+                }
+            private:
+                smart_handle file_;
+                std::string contents_;
+                std::size_t offset_ = 0;
+                read_file_handler handler_;
+            };
+        }
+
+        thread_pool_executor::thread_pool_executor( std::size_t thread_count ) :
+            completion_port_{ TINYDIR_SYSCALL( completion_port, CreateIoCompletionPort( INVALID_HANDLE_VALUE,
+                nullptr, 0, 0 ) ) }
+        {
+            if ( completion_port_ == nullptr ) {
+                throw fs::filesystem_error{ fs::details::get_windows_error( GetLastError() ),
+                    std::error_code( fs::filesystem_error_codes::handle_not_opened ) };
+            }
+            if ( thread_count == 0 ) thread_count = ( std::max )( 1u, std::thread::hardware_concurrency() );
+            threads_.reserve( thread_count );
+            for ( std::size_t i = 0; i != thread_count; ++i ) {
+                threads_.emplace_back( &thread_pool_executor::run, this );
+            }
+        }
+
+        // each thread takes exactly one stop packet, whatever was queued before them still runs
+        thread_pool_executor::~thread_pool_executor()
+        {
+            for ( std::size_t i = 0; i != threads_.size(); ++i ) {
+                PostQueuedCompletionStatus( completion_port_, 0, details::stop_key, nullptr );
+            }
+            for ( auto & t : threads_ ) t.join();
+            CloseHandle( completion_port_ );
+        }
+
+        void thread_pool_executor::post( std::function<void()> work )
+        {
+            std::unique_ptr<details::posted_work> operation{ new details::posted_work{ std::move( work ) } };
+            if ( TINYDIR_SYSCALL( completion_port, PostQueuedCompletionStatus( completion_port_, 0, 0,
+                operation.get() ) ) == 0 ) {
+                throw fs::filesystem_error{ fs::details::get_windows_error( GetLastError() ),
+                    std::error_code( fs::filesystem_error_codes::unknown_io_error ) };
+            }
+            operation.release(); // the thread that dequeues it deletes it
+        }
+
+        void thread_pool_executor::run() noexcept
+        {
+            for ( ;; ) {
+                DWORD bytes = 0;
+                ULONG_PTR key = 0;
+                LPOVERLAPPED overlapped = nullptr;
+                BOOL const dequeued = GetQueuedCompletionStatus( completion_port_, &bytes, &key, &overlapped,
+                    INFINITE );
+                if ( overlapped == nullptr ) {
+                    if ( key == details::stop_key || dequeued == 0 ) return;
+                    continue;
+                }
+                // a failed I/O still dequeues its packet, the error is the operation's to report
+                DWORD const error = dequeued ? 0 : GetLastError();
+                static_cast< details::io_operation * >( overlapped )->complete( bytes, error );
+            }
+        }
+
+        std::future<file_status> async_status( executor & ex, path const & p )
+        {
+            return async_call( ex, [p] { return fs::status( p ); } );
+        }
+
+        std::future<std::uintmax_t> async_file_size( executor & ex, path const & p )
+        {
+            return async_call( ex, [p] { return fs::file_size( p ); } );
+        }
+
+        std::future<void> async_copy( executor & ex, path const & from, path const & to )
+        {
+            return async_call( ex, [from, to] { fs::copy( from, to ); } );
+        }
+
+        std::future<bool> async_create_directories( executor & ex, path const & p )
+        {
+            return async_call( ex, [p] { return fs::create_directories( p ); } );
+        }
+
+        std::future<std::vector<directory_entry>> async_directory_listing( executor & ex, path const & p )
+        {
+            return async_call( ex, [p] {
+                return std::vector<directory_entry>( directory_iterator{ p }, directory_iterator{} );
+            } );
+        }
+
+        void async_read_file( thread_pool_executor & ex, path const & p, read_file_handler handler )
+        {
+            TINYDIR_TRACE_API( read_file );
+            HANDLE file = TINYDIR_SYSCALL( create_file, CreateFileW( p.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                nullptr, OPEN_EXISTING, FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN, nullptr ) );
+            LARGE_INTEGER size{};
+            std::error_code ec{};
+            if ( file == INVALID_HANDLE_VALUE ) {
+                ec = std::error_code( fs::filesystem_error_codes::handle_not_opened );
+            } else if ( TINYDIR_SYSCALL( get_file_size, GetFileSizeEx( file, &size ) ) == 0 ) {
+                ec = std::error_code( fs::filesystem_error_codes::could_not_obtain_size );
+            } else if ( TINYDIR_SYSCALL( completion_port, CreateIoCompletionPort( file, ex.completion_port(), 0,
+                0 ) ) == nullptr ) {
+                ec = std::error_code( fs::filesystem_error_codes::unknown_io_error );
+            } else if ( size.QuadPart != 0 ) {
+                TINYDIR_COUNT_BYTES( read_file, static_cast< std::uint64_t >( size.QuadPart ) );
+                // owned here until something else is sure to finish it: the pending read, or the posted failure
+                std::unique_ptr<details::file_read> operation{ new details::file_read{ file,
+                    static_cast< std::size_t >( size.QuadPart ), std::move( handler ) } };
+                DWORD const error = operation->start();
+                if ( error != 0 ) {
+                    details::file_read * const failed = operation.get();
+                    ex.post( [failed, error] { failed->finish( error ); } );
+                }
+                operation.release();
+                return;
+            }
+            if ( file != INVALID_HANDLE_VALUE ) CloseHandle( file );
+            // the handler always runs on the executor, failures found up front included
+            ex.post( [ec, handler] { handler( ec, std::string{} ); } );
+        }
+
+        std::future<std::string> async_read_file( thread_pool_executor & ex, path const & p )
+        {
+            auto promise = std::make_shared<std::promise<std::string>>();
+            std::future<std::string> result = promise->get_future();
+            async_read_file( ex, p, [promise, p]( std::error_code ec, std::string contents ) {
+                if ( ec ) {
+                    promise->set_exception( std::make_exception_ptr( fs::filesystem_error{ "", p, ec } ) );
+                } else {
+                    promise->set_value( std::move( contents ) );
+                }
+            } );
+            return result;
+        }
+    }
+}
@@ -0,0 +1,94 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef TINYDIRCPP_ASYNC_HPP
+#define TINYDIRCPP_ASYNC_HPP
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "tinydircpp.hpp"
+
+namespace tinydircpp {
+    namespace fs
+    {
+        // where asynchronous operations run. post() must not block; the work it is given must not throw.
+        class executor {
+        public:
+            virtual ~executor() = default;
+            virtual void post( std::function<void()> work ) = 0;
+        };
+
+        // a fixed set of threads waiting on one I/O completion port. Posted work and completed overlapped reads
+        // come out of the same queue, so a read in flight holds no thread at all.
+        // Destroy it only once the operations started on it have completed.
+        class thread_pool_executor final : public executor {
+        public:
+            // thread_count == 0 means one thread per hardware thread
+            explicit thread_pool_executor( std::size_t thread_count = 0 );
+            ~thread_pool_executor();
+            thread_pool_executor( thread_pool_executor const & ) = delete;
+            thread_pool_executor& operator=( thread_pool_executor const & ) = delete;
+
+            void post( std::function<void()> work ) override;
+            HANDLE completion_port() const noexcept { return completion_port_; }
+        private:
+            void run() noexcept;
+
+            HANDLE completion_port_;
+            std::vector<std::thread> threads_{};
+        };
+
+        // runs f on ex, the future holds its result or whatever it threw
+        template<typename Function>
+        std::future<typename std::result_of<Function()>::type> async_call( executor & ex, Function f )
+        {
+            using result_type = typename std::result_of<Function()>::type;
+            // std::function wants something copyable, a packaged_task is not
+            auto task = std::make_shared<std::packaged_task<result_type()>>( std::move( f ) );
+            std::future<result_type> result = task->get_future();
+            ex.post( [task] { ( *task )( ); } );
+            return result;
+        }
+
+        std::future<file_status> async_status( executor & ex, path const & p );
+        std::future<std::uintmax_t> async_file_size( executor & ex, path const & p );
+        std::future<void> async_copy( executor & ex, path const & from, path const & to );
+        std::future<bool> async_create_directories( executor & ex, path const & p );
+        std::future<std::vector<directory_entry>> async_directory_listing( executor & ex, path const & p );
+
+        // reads the whole of p with overlapped I/O; handler runs on one of ex's threads once the last byte is in
+        // or the read failed, it must not throw.
+        using read_file_handler = std::function<void( std::error_code, std::string )>;
+        void async_read_file( thread_pool_executor & ex, path const & p, read_file_handler handler );
+        std::future<std::string> async_read_file( thread_pool_executor & ex, path const & p );
+    }
+}
+#endif
@@ -0,0 +1,187 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "atomic_write.hpp"
+#include "instrumentation.hpp"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace tinydircpp {
+    namespace fs {
+        namespace details
+        {
+            path directory_of( path const & p )
+            {
+                path directory = p.parent_path();
+                return directory.empty() ? path{ L"." } : directory;
+            }
+
+            // the temporary goes into the target's own directory, a rename across volumes would be a copy
+            path write_temporary( path const & target, void const * data, std::size_t size )
+            {
+                static std::atomic<unsigned> next_temporary{ 0 };
+                std::wstring name = target.parent_path().native();
+                if ( !name.empty() && !is_separator( name.back() ) ) name.push_back( L'\\' );
+                name += L"." + target.filename().native() + L".tmp-" + std::to_wstring( GetCurrentProcessId() ) + L"-"
+                    + std::to_wstring( next_temporary++ );
+                path temporary{ name };
+
+                bool written = false;
+                {
+                    smart_handle file{ TINYDIR_SYSCALL( create_file, CreateFileW( temporary.c_str(), GENERIC_WRITE, 0,
+                        nullptr, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr ) ) };
+                    if ( !file ) {
+                        FSTHROW_MANUAL( fs::filesystem_error_codes::handle_not_opened, temporary );
+                    }
+                    char const * bytes = static_cast< char const * >( data );
+                    std::size_t left = size;
+                    written = true;
+                    std::size_t const max_chunk = 64 * 1024 * 1024;
+                    while ( written && left != 0 ) {
+                        DWORD const chunk = static_cast< DWORD >( ( std::min )( left, max_chunk ) );
+                        DWORD done = 0;
+                        written = TINYDIR_SYSCALL( write_file, WriteFile( file, bytes, chunk, &done, nullptr ) ) != 0;
+                        bytes += done;
+                        left -= done;
+                    }
+                    written = written && TINYDIR_SYSCALL( flush_file_buffers, FlushFileBuffers( file ) ) != 0;
+                }
+                if ( !written ) {
+                    DWORD const error = GetLastError();
+                    TINYDIR_SYSCALL( remove, DeleteFileW( temporary.c_str() ) );
+                    SetLastError( error );
+                    FSTHROW_MANUAL_DPATH( fs::filesystem_error_codes::unknown_io_error, temporary, target );
+                }
+                return temporary;
+            }
+
+            void move_over( path const & temporary, path const & target )
+            {
+                if ( TINYDIR_SYSCALL( move_file, MoveFileExW( temporary.c_str(), target.c_str(),
+                    MOVEFILE_REPLACE_EXISTING ) ) == 0 ) {
+                    DWORD const error = GetLastError();
+                    TINYDIR_SYSCALL( remove, DeleteFileW( temporary.c_str() ) );
+                    SetLastError( error );
+                    FSTHROW_MANUAL_DPATH( fs::filesystem_error_codes::unknown_io_error, temporary, target );
+                }
+            }
+        }
+
+        void atomic_write( path const & p, void const * data, std::size_t size )
+        {
+            TINYDIR_TRACE_API( atomic_write );
+            TINYDIR_COUNT_BYTES( atomic_write, size );
+            details::move_over( details::write_temporary( p, data, size ), p );
+            fs::sync( details::directory_of( p ) );
+        }
+
+        void atomic_write( path const & p, void const * data, std::size_t size, std::error_code & ec ) noexcept
+        {
+            FSERROR_TRY_CATCH( atomic_write( p, data, size ), ec );
+        }
+
+        void atomic_write( path const & p, std::string const & data )
+        {
+            atomic_write( p, data.data(), data.size() );
+        }
+
+        void atomic_write( path const & p, std::string const & data, std::error_code & ec ) noexcept
+        {
+            FSERROR_TRY_CATCH( atomic_write( p, data.data(), data.size() ), ec );
+        }
+
+        void atomic_write_batch::add( path target, std::string data )
+        {
+            writes_.emplace_back( std::move( target ), std::move( data ) );
+        }
+
+        void atomic_write_batch::commit()
+        {
+            TINYDIR_TRACE_API( atomic_write );
+            // every flush waits on the device, issuing them from several threads lets it serve them together
+            std::vector<path> temporaries( writes_.size() );
+            std::atomic<std::size_t> next_write{ 0 };
+            std::atomic<bool> failed{ false };
+            std::mutex error_mutex{};
+            std::exception_ptr error{};
+            auto const writer = [&] {
+                try {
+                    for ( std::size_t i = next_write++; !failed && i < writes_.size(); i = next_write++ ) {
+                        auto const & write = writes_[ i ];
+                        TINYDIR_COUNT_BYTES( atomic_write, write.second.size() );
+                        temporaries[ i ] = details::write_temporary( write.first, write.second.data(),
+                            write.second.size() );
+                    }
+                } catch ( ... ) {
+                    std::lock_guard<std::mutex> lock{ error_mutex };
+                    if ( !error ) error = std::current_exception();
+                    failed = true;
+                }
+            };
+            std::size_t const thread_count = ( std::min )( writes_.size(),
+                std::size_t{ ( std::max )( 1u, std::thread::hardware_concurrency() ) } );
+            std::vector<std::thread> threads{};
+            for ( std::size_t i = 1; i < thread_count; ++i ) threads.emplace_back( writer );
+            writer();
+            for ( auto & t : threads ) t.join();
+
+            auto const remove_temporaries = [&temporaries]( std::size_t from ) {
+                for ( std::size_t i = from; i < temporaries.size(); ++i ) {
+                    if ( !temporaries[ i ].empty() ) TINYDIR_SYSCALL( remove, DeleteFileW( temporaries[ i ].c_str() ) );
+                }
+            };
+            if ( error ) {
+                remove_temporaries( 0 );
+                std::rethrow_exception( error );
+            }
+
+            // directories by their case-folded name, so each is flushed only once
+            std::map<std::wstring, path> directories{};
+            for ( std::size_t i = 0; i != writes_.size(); ++i ) {
+                try {
+                    details::move_over( temporaries[ i ], writes_[ i ].first );
+                } catch ( fs::filesystem_error const & ) {
+                    remove_temporaries( i + 1 );
+                    throw;
+                }
+                path directory = details::directory_of( writes_[ i ].first );
+                directories.emplace( details::lower_case( directory.native() ), std::move( directory ) );
+            }
+            for ( auto const & directory : directories ) fs::sync( directory.second );
+            writes_.clear();
+        }
+
+        void atomic_write_batch::commit( std::error_code & ec ) noexcept
+        {
+            FSERROR_TRY_CATCH( commit(), ec );
+        }
+    }
+}
+
+#undef FSERROR_TRY_CATCH
@@ -0,0 +1,63 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef TINYDIRCPP_ATOMIC_WRITE_HPP
+#define TINYDIRCPP_ATOMIC_WRITE_HPP
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tinydircpp.hpp"
+
+namespace tinydircpp {
+    namespace fs
+    {
+        // writes data to a new file next to p, flushes it, renames it over p and flushes p's directory. Should the
+        // system go down half way, p holds either all of its old contents or all of data, never a mix of the two.
+        void atomic_write( path const & p, void const * data, std::size_t size );
+        void atomic_write( path const & p, void const * data, std::size_t size, std::error_code & ec ) noexcept;
+        void atomic_write( path const & p, std::string const & data );
+        void atomic_write( path const & p, std::string const & data, std::error_code & ec ) noexcept;
+
+        // many atomic writes committed together, which is what makes them cheap: the files are written and flushed
+        // side by side on several threads, then renamed, and every directory involved is flushed once, however many
+        // of the files it received. Each target on its own is replaced atomically; the batch as a whole is not.
+        class atomic_write_batch {
+        public:
+            void add( path target, std::string data );
+            std::size_t size() const noexcept { return writes_.size(); }
+            bool empty() const noexcept { return writes_.empty(); }
+
+            // the batch is empty after a successful commit. On failure, temporary files are removed, targets
+            // already renamed keep their new contents, and the batch keeps all of its writes for a retry.
+            void commit();
+            void commit( std::error_code & ec ) noexcept;
+        private:
+            std::vector<std::pair<path, std::string>> writes_;
+        };
+    }
+}
+#endif
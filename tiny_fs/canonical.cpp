@@ -0,0 +1,291 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "canonical.hpp"
+#include "instrumentation.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cwchar>
+#include <cwctype>
+#include <vector>
+
+namespace tinydircpp {
+    namespace fs {
+        namespace details
+        {
+            constexpr unsigned max_symlinks_followed = 40;
+
+            // index of the first component after the root name and root directory
+            std::size_t first_name( path const & p )
+            {
+                return ( p.has_root_name() ? 1 : 0 ) + ( p.has_root_directory() ? 1 : 0 );
+            }
+
+            void append_name( std::wstring & p, wchar_t const * name, std::size_t size )
+            {
+                if ( !p.empty() && p.back() != L'\\' ) p.push_back( L'\\' );
+                p.append( name, size );
+            }
+
+            // where a junction points, read_symlink() only knows about symlinks. Empty for anything else, and for
+            // the mount point of a volume without a drive letter, which leaves no path to carry on from
+            std::wstring junction_target( std::wstring const & junction )
+            {
+                smart_handle h{ TINYDIR_SYSCALL( create_file, CreateFileW( junction.c_str(), 0,
+                    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                    FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OPEN_REPARSE_POINT, nullptr ) ) };
+                if ( !h ) {
+                    FSTHROW_MANUAL( fs::filesystem_error_codes::handle_not_opened, path{ junction } );
+                }
+                union {
+                    char abyss[ offsetof( fs::REPARSE_DATA_BUFFER, GenericReparseBuffer ) + ( 1024 * 16 ) ];
+                    fs::REPARSE_DATA_BUFFER reparse_buffer;
+                } data;
+                DWORD returned_data_size = 0;
+                if ( TINYDIR_SYSCALL( device_io_control, DeviceIoControl( h, FSCTL_GET_REPARSE_POINT, nullptr, 0,
+                    &data.reparse_buffer, sizeof( data ), &returned_data_size, nullptr ) ) == 0 ) {
+                    FSTHROW_MANUAL( fs::filesystem_error_codes::unknown_io_error, path{ junction } );
+                }
+                if ( data.reparse_buffer.ReparseTag != IO_REPARSE_TAG_MOUNT_POINT ) return std::wstring{};
+                // the substitute name is always there, as \??\C:\target; the print name may be left empty
+                auto const & mount_point = data.reparse_buffer.MountPointReparseBuffer;
+                std::wstring target( mount_point.PathBuffer + mount_point.SubstituteNameOffset / 2,
+                    mount_point.SubstituteNameLength / 2 );
+                if ( target.compare( 0, 4, L"\\??\\" ) == 0 ) target.erase( 0, 4 );
+                if ( target.compare( 0, 7, L"Volume{" ) == 0 ) return std::wstring{};
+                return target;
+            }
+        }
+
+        path normpath( path const & p )
+        {
+            std::wstring result = p.root_name_component().wstring();
+            std::replace( result.begin(), result.end(), L'/', L'\\' );
+            bool const rooted = p.has_root_directory();
+            if ( rooted ) result.push_back( L'\\' );
+
+            path_component const dot{ L".", 1 }, dot_dot{ L"..", 2 };
+            std::vector<path_component> names{};
+            for ( std::size_t i = details::first_name( p ); i < p.component_count(); ++i ) {
+                path_component const name = p.component( i );
+                if ( name == dot ) continue;
+                if ( name == dot_dot ) {
+                    if ( !names.empty() && names.back() != dot_dot ) {
+                        names.pop_back();
+                        continue;
+                    }
+                    if ( rooted ) continue; // nothing is above the root
+                }
+                names.push_back( name );
+            }
+            for ( std::size_t i = 0; i != names.size(); ++i ) {
+                if ( i != 0 ) result.push_back( L'\\' );
+                result.append( names[ i ].data(), names[ i ].size() );
+            }
+            return result.empty() ? path{ L"." } : path{ result };
+        }
+
+        path relpath( path const & p, path const & start )
+        {
+            path const target = normpath( abspath( p ) ), base = normpath( abspath( start ) );
+            if ( details::lower_case( target.root_name().native() )
+                != details::lower_case( base.root_name().native() ) ) {
+                throw fs::filesystem_error{ "paths on different roots have no relative path", p, start,
+                    std::make_error_code( std::errc::invalid_argument ) };
+            }
+            std::size_t t = details::first_name( target ), b = details::first_name( base );
+            while ( t < target.component_count() && b < base.component_count()
+                && details::lower_case( target.component( t ).wstring() )
+                == details::lower_case( base.component( b ).wstring() ) ) {
+                ++t;
+                ++b;
+            }
+            std::wstring result{};
+            for ( ; b < base.component_count(); ++b ) details::append_name( result, L"..", 2 );
+            for ( ; t < target.component_count(); ++t ) {
+                path_component const name = target.component( t );
+                details::append_name( result, name.data(), name.size() );
+            }
+            return result.empty() ? path{ L"." } : path{ result };
+        }
+
+        path relpath( path const & p, path const & start, std::error_code & ec ) noexcept
+        {
+            FSERROR_TRY_CATCH( return relpath( p, start ), ec );
+            return path{};
+        }
+
+        path relpath( path const & p )
+        {
+            return relpath( p, current_path() );
+        }
+
+        path relpath( path const & p, std::error_code & ec ) noexcept
+        {
+            FSERROR_TRY_CATCH( return relpath( p ), ec );
+            return path{};
+        }
+
+        path_resolver::path_resolver( std::size_t capacity ) : capacity_{ ( std::max )( capacity, std::size_t{ 1 } ) }
+        {
+        }
+
+        path path_resolver::realpath( path const & p )
+        {
+            TINYDIR_TRACE_API( realpath );
+            unsigned links_followed = 0;
+            return path{ resolve( normpath( abspath( p ) ), p, links_followed ) };
+        }
+
+        path path_resolver::realpath( path const & p, std::error_code & ec ) noexcept
+        {
+            FSERROR_TRY_CATCH( return realpath( p ), ec );
+            return path{};
+        }
+
+        std::wstring path_resolver::resolve( path const & absolute, path const & original, unsigned & links_followed )
+        {
+            std::wstring current = absolute.root_name_component().wstring();
+            // drive letters as the system shows them, so that c:\ and C:\ don't resolve to two spellings
+            if ( current.size() == 2 && current[ 1 ] == L':' ) current[ 0 ] = std::towupper( current[ 0 ] );
+            if ( absolute.has_root_directory() ) current.push_back( L'\\' );
+            for ( std::size_t i = details::first_name( absolute ); i < absolute.component_count(); ++i ) {
+                path_component const name = absolute.component( i );
+                std::wstring candidate = current;
+                details::append_name( candidate, name.data(), name.size() );
+                std::wstring const key = details::lower_case( candidate );
+                std::wstring resolved{};
+                if ( find( key, resolved ) ) {
+                    current = std::move( resolved );
+                    continue;
+                }
+                // no name has wildcards in it, the search below would take them for a pattern
+                if ( std::find_if( name.data(), name.data() + name.size(), []( wchar_t c ) {
+                    return c == L'*' || c == L'?';
+                } ) != name.data() + name.size() ) {
+                    FSTHROW( std::errc::no_such_file_or_directory, original );
+                }
+
+                // the directory entry has the name as it is spelt on disk, whoever asked first and however they
+                // spelt it. Where the parent can't be listed the name is kept as it was asked for
+                WIN32_FIND_DATAW find_data{};
+                HANDLE const search_handle = TINYDIR_SYSCALL( find_first_file, FindFirstFileExW( candidate.c_str(),
+                    FindExInfoBasic, &find_data, FindExSearchNameMatch, nullptr, 0 ) );
+                resolved = current;
+                if ( search_handle != INVALID_HANDLE_VALUE ) {
+                    FindClose( search_handle );
+                    details::append_name( resolved, find_data.cFileName, std::wcslen( find_data.cFileName ) );
+                } else {
+                    find_data.dwFileAttributes = TINYDIR_SYSCALL( get_file_attributes,
+                        GetFileAttributesW( candidate.c_str() ) );
+                    if ( find_data.dwFileAttributes == INVALID_FILE_ATTRIBUTES ) {
+                        FSTHROW( std::errc::no_such_file_or_directory, original );
+                    }
+                    resolved = candidate;
+                }
+                if ( find_data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT ) {
+                    DWORD const tag = find_data.dwReserved0; // 0 when only the attributes could be read
+                    path target = tag == 0 || tag == IO_REPARSE_TAG_SYMLINK ? read_symlink( path{ resolved } ) : path{};
+                    if ( target.empty() && ( tag == 0 || tag == IO_REPARSE_TAG_MOUNT_POINT ) ) {
+                        target = path{ details::junction_target( resolved ) };
+                    }
+                    if ( !target.empty() ) {
+                        if ( ++links_followed > details::max_symlinks_followed ) {
+                            FSTHROW( std::errc::too_many_symbolic_link_levels, original );
+                        }
+                        // a relative target is relative to the directory holding the link, one that starts with a
+                        // separator (\x) to the root of the drive the link is on
+                        std::wstring absolute_target = target.native();
+                        if ( !target.is_absolute() ) {
+                            if ( details::is_separator( absolute_target.front() ) ) {
+                                absolute_target = path{ current }.root_name_component().wstring() + absolute_target;
+                            } else {
+                                absolute_target = current;
+                                details::append_name( absolute_target, target.c_str(), target.native().size() );
+                            }
+                        }
+                        resolved = resolve( normpath( path{ absolute_target } ), original, links_followed );
+                    }
+                }
+                remember( key, resolved );
+                current = std::move( resolved );
+            }
+            return current;
+        }
+
+        bool path_resolver::find( std::wstring const & key, std::wstring & resolved )
+        {
+            std::lock_guard<std::mutex> lock{ mutex_ };
+            auto const iter = index_.find( key );
+            if ( iter == index_.end() ) return false;
+            recent_.splice( recent_.begin(), recent_, iter->second );
+            resolved = iter->second->second;
+            return true;
+        }
+
+        void path_resolver::remember( std::wstring const & key, std::wstring const & resolved )
+        {
+            std::lock_guard<std::mutex> lock{ mutex_ };
+            auto const iter = index_.find( key );
+            if ( iter != index_.end() ) {
+                iter->second->second = resolved;
+                recent_.splice( recent_.begin(), recent_, iter->second );
+                return;
+            }
+            recent_.emplace_front( key, resolved );
+            index_.emplace( key, recent_.begin() );
+            if ( recent_.size() > capacity_ ) {
+                index_.erase( recent_.back().first );
+                recent_.pop_back();
+            }
+        }
+
+        void path_resolver::clear() noexcept
+        {
+            std::lock_guard<std::mutex> lock{ mutex_ };
+            index_.clear();
+            recent_.clear();
+        }
+
+        std::size_t path_resolver::size() const noexcept
+        {
+            std::lock_guard<std::mutex> lock{ mutex_ };
+            return recent_.size();
+        }
+
+        path realpath( path const & p )
+        {
+            return path_resolver{ 256 }.realpath( p );
+        }
+
+        path realpath( path const & p, std::error_code & ec ) noexcept
+        {
+            FSERROR_TRY_CATCH( return realpath( p ), ec );
+            return path{};
+        }
+    }
+}
+
+#undef FSERROR_TRY_CATCH
@@ -0,0 +1,86 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef TINYDIRCPP_CANONICAL_HPP
+#define TINYDIRCPP_CANONICAL_HPP
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "tinydircpp.hpp"
+
+namespace tinydircpp {
+    namespace fs
+    {
+        // purely lexical: '/' becomes '\', repeated separators, "." and ".." are folded away. ".." never climbs
+        // above the root of an absolute path. Nothing is looked up, so symlinks are not taken into account.
+        path normpath( path const & p );
+
+        // p relative to start (the current directory by default), worked out lexically once both are absolute.
+        // Paths on different drives or shares have no relative form and are reported as invalid_argument.
+        path relpath( path const & p, path const & start );
+        path relpath( path const & p, path const & start, std::error_code & ec ) noexcept;
+        path relpath( path const & p );
+        path relpath( path const & p, std::error_code & ec ) noexcept;
+
+        // resolves symlinks one component at a time and remembers what every prefix it looked at resolved to,
+        // in a cache of at most capacity prefixes. Canonicalizing many paths under the same directories then
+        // costs a few hash lookups instead of a chain of link reads. The cache is not told about links that
+        // change afterwards, clear() it when they might have. Safe to share between threads.
+        class path_resolver {
+        public:
+            explicit path_resolver( std::size_t capacity = 4096 );
+            path_resolver( path_resolver const & ) = delete;
+            path_resolver& operator=( path_resolver const & ) = delete;
+
+            // the absolute path of p with no symlinks or junctions in it; every component must exist. Names come
+            // back spelt the way they are on disk and drive letters in upper case, whatever the cache saw first.
+            // The server and share of a UNC path are the exception, they keep the spelling first asked for.
+            path realpath( path const & p );
+            path realpath( path const & p, std::error_code & ec ) noexcept;
+            void clear() noexcept;
+            std::size_t size() const noexcept;
+        private:
+            using lru_list = std::list<std::pair<std::wstring, std::wstring>>; // most recent first
+
+            std::wstring resolve( path const & absolute, path const & original, unsigned & links_followed );
+            bool find( std::wstring const & key, std::wstring & resolved );
+            void remember( std::wstring const & key, std::wstring const & resolved );
+
+            std::size_t const capacity_;
+            mutable std::mutex mutex_{};
+            lru_list recent_{};
+            std::unordered_map<std::wstring, lru_list::iterator> index_{};
+        };
+
+        // realpath with a resolver of its own, nothing is remembered between calls
+        path realpath( path const & p );
+        path realpath( path const & p, std::error_code & ec ) noexcept;
+    }
+}
+#endif
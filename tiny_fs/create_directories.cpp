@@ -0,0 +1,235 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "create_directories.hpp"
+#include "instrumentation.hpp"
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace tinydircpp {
+    namespace fs {
+        namespace details
+        {
+            struct directory_node {
+                std::wstring full_path{};
+                // keyed by the lower-cased name, Windows would create "A" and "a" as one directory anyway
+                std::map<std::wstring, std::unique_ptr<directory_node>> children{};
+            };
+
+            // length of the part of p that is never created: "C:\", "\\server\share\", "\\?\C:\" or nothing
+            std::size_t root_length( std::wstring const & p ) noexcept
+            {
+                std::size_t i = 0;
+                bool unc = false;
+                if ( p.compare( 0, 4, L"\\\\?\\" ) == 0 ) {
+                    i = 4;
+                    if ( p.compare( 4, 4, L"UNC\\" ) == 0 ) {
+                        i = 8;
+                        unc = true;
+                    }
+                } else if ( p.size() > 1 && is_separator( p[ 0 ] ) && is_separator( p[ 1 ] ) ) {
+                    i = 2;
+                    unc = true;
+                }
+                if ( unc ) {
+                    for ( int part = 0; part != 2; ++part ) { // server, then share
+                        while ( i < p.size() && !is_separator( p[ i ] ) ) ++i;
+                        if ( part == 0 && i < p.size() ) ++i;
+                    }
+                } else if ( p.size() >= i + 2 && p[ i + 1 ] == L':' ) {
+                    i += 2;
+                }
+                if ( i < p.size() && is_separator( p[ i ] ) ) ++i;
+                return i;
+            }
+
+            std::wstring join( std::wstring const & parent, std::wstring const & name )
+            {
+                if ( parent.empty() || is_separator( parent.back() ) || parent.back() == L':' ) return parent + name;
+                return parent + L'\\' + name;
+            }
+
+            class directory_tree {
+            public:
+                void insert( std::wstring const & p )
+                {
+                    std::size_t const root_size = root_length( p );
+                    std::vector<std::wstring> components{};
+                    for ( std::size_t first = root_size; first < p.size(); ) {
+                        std::size_t last = first;
+                        while ( last < p.size() && !is_separator( p[ last ] ) ) ++last;
+                        std::wstring name = p.substr( first, last - first );
+                        first = last + 1;
+                        if ( name.empty() || name == L"." ) continue;
+                        if ( name == L".." && !components.empty() && components.back() != L".." ) {
+                            components.pop_back();
+                        } else {
+                            components.push_back( std::move( name ) );
+                        }
+                    }
+
+                    std::wstring const root = p.substr( 0, root_size );
+                    auto & root_node = roots_[ lower_case( root ) ];
+                    if ( !root_node ) {
+                        root_node.reset( new directory_node{} );
+                        root_node->full_path = root;
+                    }
+                    directory_node * node = root_node.get();
+                    for ( auto const & name : components ) {
+                        auto & child = node->children[ lower_case( name ) ];
+                        if ( !child ) {
+                            child.reset( new directory_node{} );
+                            child->full_path = join( node->full_path, name );
+                        }
+                        node = child.get();
+                    }
+                }
+
+                // the directories right below the roots, which always exist
+                std::vector<directory_node const *> top_level() const
+                {
+                    std::vector<directory_node const *> nodes{};
+                    for ( auto const & root : roots_ ) {
+                        for ( auto const & child : root.second->children ) nodes.push_back( child.second.get() );
+                    }
+                    return nodes;
+                }
+            private:
+                std::map<std::wstring, std::unique_ptr<directory_node>> roots_{};
+            };
+
+            class tree_creator {
+            public:
+                // creates node, and its subtree once node is known to be there
+                void create( directory_node const & node )
+                {
+                    if ( !make( node ) ) return;
+                    for ( auto const & child : node.children ) create( *child.second );
+                }
+
+                bool make( directory_node const & node )
+                {
+                    if ( TINYDIR_SYSCALL( create_directory, CreateDirectoryW( node.full_path.c_str(),
+                        nullptr ) ) != 0 ) {
+                        ++created_;
+                        return true;
+                    }
+                    DWORD const error = GetLastError();
+                    // something is there already, which only helps if it is a directory
+                    if ( error == ERROR_ALREADY_EXISTS ) {
+                        DWORD const attributes = TINYDIR_SYSCALL( get_file_attributes,
+                            GetFileAttributesW( node.full_path.c_str() ) );
+                        if ( attributes != INVALID_FILE_ATTRIBUTES && ( attributes & FILE_ATTRIBUTE_DIRECTORY ) ) {
+                            return true;
+                        }
+                    }
+                    std::lock_guard<std::mutex> lock{ mutex_ };
+                    if ( error_ == 0 ) {
+                        error_ = error;
+                        failed_path_ = node.full_path;
+                    }
+                    return false;
+                }
+
+                std::uintmax_t created() const noexcept { return created_; }
+
+                void throw_if_failed() const
+                {
+                    if ( error_ == 0 ) return;
+                    std::error_code ec{};
+                    switch ( error_ ) {
+                    case ERROR_FILENAME_EXCED_RANGE:
+                        ec = std::make_error_code( std::errc::filename_too_long );
+                        break;
+                    case ERROR_PATH_NOT_FOUND:
+                        ec = std::make_error_code( std::errc::no_such_file_or_directory );
+                        break;
+                    case ERROR_ALREADY_EXISTS:
+                        ec = std::make_error_code( std::errc::not_a_directory );
+                        break;
+                    default:
+                        ec = std::error_code( fs::filesystem_error_codes::unknown_io_error );
+                    }
+                    throw fs::filesystem_error{ fs::details::get_windows_error( error_ ), path{ failed_path_ }, ec };
+                }
+            private:
+                std::atomic<std::uintmax_t> created_{ 0 };
+                std::mutex mutex_{};
+                DWORD error_ = 0;
+                std::wstring failed_path_{};
+            };
+        }
+
+        std::uintmax_t create_directories( std::vector<path> const & targets, std::size_t thread_count )
+        {
+            TINYDIR_TRACE_API( bulk_create_directories );
+            details::directory_tree tree{};
+            for ( auto const & target : targets ) tree.insert( target.native() );
+
+            if ( thread_count == 0 ) thread_count = ( std::max )( 1u, std::thread::hardware_concurrency() );
+            details::tree_creator creator{};
+
+            // create the top of the tree a level at a time until there are enough independent subtrees to go
+            // around, a tree with a single trunk would otherwise leave all but one thread idle
+            std::vector<details::directory_node const *> subtrees = tree.top_level();
+            while ( thread_count > 1 && !subtrees.empty() && subtrees.size() < thread_count * 4 ) {
+                std::vector<details::directory_node const *> next_level{};
+                for ( auto const node : subtrees ) {
+                    if ( !creator.make( *node ) ) continue;
+                    for ( auto const & child : node->children ) next_level.push_back( child.second.get() );
+                }
+                subtrees.swap( next_level );
+            }
+
+            std::atomic<std::size_t> next_subtree{ 0 };
+            auto const worker = [&] {
+                for ( std::size_t i = next_subtree++; i < subtrees.size(); i = next_subtree++ ) {
+                    creator.create( *subtrees[ i ] );
+                }
+            };
+            std::vector<std::thread> threads{};
+            std::size_t const worker_count = ( std::min )( thread_count, subtrees.size() );
+            for ( std::size_t i = 1; i < worker_count; ++i ) threads.emplace_back( worker );
+            worker();
+            for ( auto & t : threads ) t.join();
+
+            creator.throw_if_failed();
+            return creator.created();
+        }
+
+        std::uintmax_t create_directories( std::vector<path> const & targets, std::error_code & ec,
+            std::size_t thread_count ) noexcept
+        {
+            FSERROR_TRY_CATCH( return create_directories( targets, thread_count ), ec );
+            return 0;
+        }
+    }
+}
+
+#undef FSERROR_TRY_CATCH
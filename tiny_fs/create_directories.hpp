@@ -0,0 +1,49 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef TINYDIRCPP_CREATE_DIRECTORIES_HPP
+#define TINYDIRCPP_CREATE_DIRECTORIES_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "tinydircpp.hpp"
+
+namespace tinydircpp {
+    namespace fs
+    {
+        // creates every directory in targets along with any missing parent. The targets are merged into one tree
+        // first, so a parent shared by many targets is created (or found to exist) by exactly one system call. A path
+        // is only stat-ed when it already exists, to tell a directory from a file in the way, which fails as
+        // not_a_directory. Subtrees that do not share a parent are created in parallel on up to
+        // thread_count threads (one per hardware thread when 0). "." and ".." are resolved lexically.
+        // Returns the number of directories that did not exist before; on failure the first failing path is
+        // reported after every independent subtree has been attempted.
+        std::uintmax_t create_directories( std::vector<path> const & targets, std::size_t thread_count = 0 );
+        std::uintmax_t create_directories( std::vector<path> const & targets, std::error_code & ec,
+            std::size_t thread_count = 0 ) noexcept;
+    }
+}
+#endif
@@ -0,0 +1,222 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "directory_lookup.hpp"
+#include "instrumentation.hpp"
+#include "scandir.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cwctype>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace tinydircpp {
+    namespace fs {
+        namespace details
+        {
+            // FNV-1a, over names already folded to lower case
+            std::uint64_t name_hash( wchar_t const * name, std::size_t size ) noexcept
+            {
+                std::uint64_t hash = 14695981039346656037ULL;
+                for ( std::size_t i = 0; i != size; ++i ) {
+                    hash = ( hash ^ static_cast< std::uint64_t >( name[ i ] ) ) * 1099511628211ULL;
+                }
+                return hash;
+            }
+
+            // the names of one directory: their text back to back in one block, and a table of (hash, offset)
+            // pairs sorted by hash to find them in
+            class name_set {
+            public:
+                using clock = std::chrono::steady_clock;
+
+                name_set( std::uint64_t write_time, bool racy, clock::time_point checked ) noexcept :
+                    checked{ checked.time_since_epoch().count() }, write_time_{ write_time }, racy_{ racy }
+                {
+                }
+
+                void add( wchar_t const * name, std::size_t size )
+                {
+                    std::size_t const offset = names_.size();
+                    for ( std::size_t i = 0; i != size; ++i ) {
+                        names_.push_back( static_cast< wchar_t >( std::towlower( name[ i ] ) ) );
+                    }
+                    names_.push_back( L'\0' );
+                    slots_.emplace_back( name_hash( names_.data() + offset, size ),
+                        static_cast< std::uint32_t >( offset ) );
+                }
+
+                void seal()
+                {
+                    std::sort( slots_.begin(), slots_.end() );
+                    names_.shrink_to_fit();
+                    slots_.shrink_to_fit();
+                }
+
+                bool contains( std::wstring const & folded_name ) const noexcept
+                {
+                    std::uint64_t const hash = name_hash( folded_name.data(), folded_name.size() );
+                    auto slot = std::lower_bound( slots_.begin(), slots_.end(),
+                        std::pair<std::uint64_t, std::uint32_t>{ hash, 0 } );
+                    for ( ; slot != slots_.end() && slot->first == hash; ++slot ) {
+                        if ( folded_name.compare( names_.data() + slot->second ) == 0 ) return true;
+                    }
+                    return false;
+                }
+
+                std::uint64_t write_time() const noexcept { return write_time_; }
+                // the listing was made so soon after the directory last changed that another change could have
+                // followed within the same tick of the file system's clock, leaving the write time as it was
+                bool racy() const noexcept { return racy_; }
+
+                // when the write time was last found unchanged, in clock ticks
+                std::atomic<clock::rep> checked;
+            private:
+                std::uint64_t const write_time_;
+                bool const racy_;
+                std::vector<wchar_t> names_{};
+                std::vector<std::pair<std::uint64_t, std::uint32_t>> slots_{};
+            };
+
+            // false when there is no directory to list, which is not an error here
+            bool directory_write_time( path const & directory, std::uint64_t & write_time )
+            {
+                WIN32_FILE_ATTRIBUTE_DATA data{};
+                if ( TINYDIR_SYSCALL( get_file_attributes, GetFileAttributesExW( directory.c_str(),
+                    GetFileExInfoStandard, &data ) ) == 0 ) {
+                    DWORD const error = GetLastError();
+                    if ( error != ERROR_FILE_NOT_FOUND && error != ERROR_PATH_NOT_FOUND ) {
+                        FSTHROW_MANUAL( fs::filesystem_error_codes::could_not_obtain_time, directory );
+                    }
+                    write_time = 0;
+                    return false;
+                }
+                write_time = ( static_cast< std::uint64_t >( data.ftLastWriteTime.dwHighDateTime ) << 32 )
+                    | data.ftLastWriteTime.dwLowDateTime;
+                return ( data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) != 0;
+            }
+
+            // NTFS takes its times from a clock that only ticks every few milliseconds, a second is plenty
+            bool is_racy( std::uint64_t write_time ) noexcept
+            {
+                auto const since_epoch = std::chrono::duration_cast< filetime_ticks >(
+                    std::chrono::system_clock::now().time_since_epoch() );
+                std::int64_t const now = since_epoch.count() + unix_epoch_ticks;
+                std::int64_t const window = filetime_ticks{ std::chrono::seconds{ 1 } }.count();
+                return now - static_cast< std::int64_t >( write_time ) < window;
+            }
+        }
+
+        directory_lookup::directory_lookup( directory_lookup_options const & options ) : options_{ options }
+        {
+        }
+
+        directory_lookup::~directory_lookup() = default;
+
+        std::shared_ptr<details::name_set> directory_lookup::names_of( path const & directory )
+        {
+            using clock = details::name_set::clock;
+            std::wstring key = details::lower_case( directory.native() );
+            auto const now = clock::now();
+            std::shared_ptr<details::name_set> known{};
+            {
+                std::shared_lock<std::shared_timed_mutex> lock{ mutex_ };
+                auto const found = directories_.find( key );
+                if ( found != directories_.end() ) known = found->second;
+            }
+            if ( known && now - clock::time_point{ clock::duration{ known->checked } } < options_.revalidate_after ) {
+                return known;
+            }
+
+            // the write time is taken before the listing, so a change made while listing shows up next time
+            std::uint64_t write_time = 0;
+            bool const listable = details::directory_write_time( directory, write_time );
+            if ( known && known->write_time() == write_time && !known->racy() ) {
+                known->checked = now.time_since_epoch().count();
+                return known;
+            }
+            auto fresh = std::make_shared<details::name_set>( write_time, listable && details::is_racy( write_time ),
+                now );
+            if ( listable ) {
+                for ( auto const & entry : scandir( directory, scandir_filter{}, scandir_sort::none ) ) {
+                    fresh->add( entry.name(), entry.name_size() );
+                }
+            }
+            fresh->seal();
+            std::unique_lock<std::shared_timed_mutex> lock{ mutex_ };
+            directories_[ std::move( key ) ] = fresh;
+            return fresh;
+        }
+
+        bool directory_lookup::contains( path const & directory, std::wstring const & name )
+        {
+            TINYDIR_TRACE_API( directory_lookup );
+            auto const names = names_of( directory );
+            return names->contains( details::lower_case( name ) );
+        }
+
+        bool directory_lookup::contains( path const & directory, std::wstring const & name,
+            std::error_code & ec ) noexcept
+        {
+            FSERROR_TRY_CATCH( return contains( directory, name ), ec );
+            return false;
+        }
+
+        bool directory_lookup::exists( path const & p )
+        {
+            path const name = p.filename();
+            if ( name.empty() ) return fs::exists( p ); // a root, it has no directory to look in
+            path const directory = p.parent_path();
+            return contains( directory.empty() ? path{ L"." } : directory, name.native() );
+        }
+
+        bool directory_lookup::exists( path const & p, std::error_code & ec ) noexcept
+        {
+            FSERROR_TRY_CATCH( return exists( p ), ec );
+            return false;
+        }
+
+        void directory_lookup::forget( path const & directory )
+        {
+            std::unique_lock<std::shared_timed_mutex> lock{ mutex_ };
+            directories_.erase( details::lower_case( directory.native() ) );
+        }
+
+        void directory_lookup::clear() noexcept
+        {
+            std::unique_lock<std::shared_timed_mutex> lock{ mutex_ };
+            directories_.clear();
+        }
+
+        std::size_t directory_lookup::size() const noexcept
+        {
+            std::shared_lock<std::shared_timed_mutex> lock{ mutex_ };
+            return directories_.size();
+        }
+    }
+}
+
+#undef FSERROR_TRY_CATCH
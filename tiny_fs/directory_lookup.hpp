@@ -0,0 +1,82 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef TINYDIRCPP_DIRECTORY_LOOKUP_HPP
+#define TINYDIRCPP_DIRECTORY_LOOKUP_HPP
+
+#include <chrono>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+#include "tinydircpp.hpp"
+
+namespace tinydircpp {
+    namespace fs
+    {
+        namespace details {
+            class name_set;
+        }
+
+        struct directory_lookup_options {
+            // how long the names read from a directory are trusted before its write time is looked at again;
+            // within that time an answer costs no system call at all
+            std::chrono::milliseconds revalidate_after{ 1000 };
+        };
+
+        // answers whether a directory has an entry of a given name from a copy of all of its names, which makes it
+        // the tool for probing many names, most of them absent, under a few directories: the names are read in a
+        // single listing, kept as one block of text with a sorted table of hashes, and read again only when the
+        // directory's write time has moved on (creating, deleting or renaming an entry in it does that).
+        // Names compare without regard to case, like the file system's do. Safe to use from any number of threads.
+        class directory_lookup {
+        public:
+            explicit directory_lookup( directory_lookup_options const & options = directory_lookup_options{} );
+            ~directory_lookup();
+            directory_lookup( directory_lookup const & ) = delete;
+            directory_lookup& operator=( directory_lookup const & ) = delete;
+
+            // a directory that does not exist has no entries, and is remembered as such just the same
+            bool contains( path const & directory, std::wstring const & name );
+            bool contains( path const & directory, std::wstring const & name, std::error_code & ec ) noexcept;
+            // whether p's directory has an entry of p's file name
+            bool exists( path const & p );
+            bool exists( path const & p, std::error_code & ec ) noexcept;
+
+            void forget( path const & directory );
+            void clear() noexcept;
+            // the number of directories whose names are held
+            std::size_t size() const noexcept;
+        private:
+            std::shared_ptr<details::name_set> names_of( path const & directory );
+
+            directory_lookup_options options_;
+            mutable std::shared_timed_mutex mutex_{};
+            std::unordered_map<std::wstring, std::shared_ptr<details::name_set>> directories_{};
+        };
+    }
+}
+#endif
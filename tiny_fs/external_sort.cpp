@@ -0,0 +1,352 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "external_sort.hpp"
+#include "arena.hpp"
+#include "instrumentation.hpp"
+#include <algorithm>
+#include <atomic>
+#include <queue>
+#include <utility>
+
+namespace tinydircpp {
+    namespace fs {
+        namespace details
+        {
+            constexpr std::size_t run_write_buffer = 256 * 1024;
+            constexpr std::size_t min_run_read_buffer = 64 * 1024;
+
+            HANDLE open_run_file( path const & directory, path & file_path )
+            {
+                static std::atomic<unsigned> next_run{ 0 };
+                for ( ;; ) {
+                    std::wstring name = directory.native();
+                    if ( !name.empty() && !is_separator( name.back() ) ) name.push_back( L'\\' );
+                    name += L"tinydir-sort-" + std::to_wstring( GetCurrentProcessId() ) + L"-"
+                        + std::to_wstring( next_run++ ) + L".run";
+                    file_path = path{ name };
+                    // the run is deleted by the system when its handle is closed, even if this process is killed
+                    HANDLE const file = TINYDIR_SYSCALL( create_file, CreateFileW( name.c_str(),
+                        GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_NEW,
+                        FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE | FILE_FLAG_SEQUENTIAL_SCAN, nullptr ) );
+                    if ( file != INVALID_HANDLE_VALUE || GetLastError() != ERROR_FILE_EXISTS ) return file;
+                }
+            }
+
+            // a sorted run on disk. Entries are written as: varint path size, the path's UTF-16 code units, type
+            // byte, varint size, varint write time
+            class sort_run {
+            public:
+                explicit sort_run( path const & directory ) : file_{ open_run_file( directory, file_path_ ) }
+                {
+                    if ( !file_ ) FSTHROW_MANUAL( fs::filesystem_error_codes::handle_not_opened, file_path_ );
+                    buffer_.reserve( run_write_buffer );
+                }
+
+                void write( wchar_t const * p, std::size_t path_size, file_type type, std::uintmax_t size,
+                    std::uint64_t write_time_ticks )
+                {
+                    put_varint( path_size );
+                    char const * const bytes = reinterpret_cast< char const * >( p );
+                    buffer_.insert( buffer_.end(), bytes, bytes + path_size * sizeof( wchar_t ) );
+                    buffer_.push_back( static_cast< char >( static_cast< int >( type ) ) );
+                    put_varint( size );
+                    put_varint( write_time_ticks );
+                    if ( buffer_.size() >= run_write_buffer ) flush();
+                }
+
+                // writes out what is buffered and gives the buffer back, until the run is read
+                void finish_writing()
+                {
+                    flush();
+                    std::vector<char>{}.swap( buffer_ );
+                }
+
+                void rewind( std::size_t read_buffer_size )
+                {
+                    flush();
+                    if ( TINYDIR_SYSCALL( set_file_pointer, SetFilePointer( file_, 0, nullptr, FILE_BEGIN ) )
+                        == INVALID_SET_FILE_POINTER ) {
+                        FSTHROW_MANUAL( fs::filesystem_error_codes::unknown_io_error, file_path_ );
+                    }
+                    buffer_.resize( read_buffer_size );
+                    position_ = available_ = 0;
+                }
+
+                bool read( sorted_entry & entry )
+                {
+                    std::uint64_t path_size = 0;
+                    if ( !get_varint( path_size ) ) return false;
+                    entry.path.resize( static_cast< std::size_t >( path_size ) );
+                    char type = 0;
+                    if ( ( path_size != 0 && !get( reinterpret_cast< char * >( &entry.path[ 0 ] ),
+                        static_cast< std::size_t >( path_size ) * sizeof( wchar_t ) ) ) || !get( &type, 1 )
+                        || !get_varint( entry.size ) || !get_varint( entry.write_time_ticks ) ) {
+                        SetLastError( ERROR_HANDLE_EOF );
+                        FSTHROW_MANUAL( fs::filesystem_error_codes::unknown_io_error, file_path_ );
+                    }
+                    entry.type = static_cast< file_type >( static_cast< signed char >( type ) );
+                    return true;
+                }
+            private:
+                void put_varint( std::uint64_t value )
+                {
+                    while ( value >= 0x80 ) {
+                        buffer_.push_back( static_cast< char >( ( value & 0x7F ) | 0x80 ) );
+                        value >>= 7;
+                    }
+                    buffer_.push_back( static_cast< char >( value ) );
+                }
+
+                bool get_varint( std::uint64_t & value )
+                {
+                    value = 0;
+                    for ( unsigned shift = 0; shift < 64; shift += 7 ) {
+                        char c = 0;
+                        if ( !get( &c, 1 ) ) return false;
+                        value |= static_cast< std::uint64_t >( c & 0x7F ) << shift;
+                        if ( ( c & 0x80 ) == 0 ) return true;
+                    }
+                    return false;
+                }
+
+                bool get( char * out, std::size_t bytes )
+                {
+                    while ( bytes != 0 ) {
+                        if ( position_ == available_ ) {
+                            DWORD read = 0;
+                            if ( !TINYDIR_SYSCALL( read_file, ReadFile( file_, buffer_.data(),
+                                static_cast< DWORD >( buffer_.size() ), &read, nullptr ) ) ) {
+                                FSTHROW_MANUAL( fs::filesystem_error_codes::unknown_io_error, file_path_ );
+                            }
+                            if ( read == 0 ) return false;
+                            position_ = 0;
+                            available_ = read;
+                        }
+                        std::size_t const chunk = std::min( bytes, available_ - position_ );
+                        std::copy_n( buffer_.data() + position_, chunk, out );
+                        position_ += chunk;
+                        out += chunk;
+                        bytes -= chunk;
+                    }
+                    return true;
+                }
+
+                void flush()
+                {
+                    std::size_t written = 0;
+                    while ( written != buffer_.size() ) {
+                        DWORD chunk = 0;
+                        if ( !TINYDIR_SYSCALL( write_file, WriteFile( file_, buffer_.data() + written,
+                            static_cast< DWORD >( buffer_.size() - written ), &chunk, nullptr ) ) ) {
+                            FSTHROW_MANUAL( fs::filesystem_error_codes::unknown_io_error, file_path_ );
+                        }
+                        written += chunk;
+                    }
+                    buffer_.clear();
+                }
+
+                path file_path_;
+                smart_handle file_;
+                std::vector<char> buffer_;
+                std::size_t position_ = 0;
+                std::size_t available_ = 0;
+            };
+
+            using sorted_entry_visitor = std::function<void( sorted_entry const & )>;
+
+            void merge_runs( std::vector<sort_run *> const & runs, std::size_t read_buffer_size,
+                sorted_entry_visitor const & visitor )
+            {
+                std::vector<sorted_entry> heads( runs.size() );
+                // a min-heap of runs by their next entry, equal paths leave the earlier run first
+                auto const later = [&heads]( std::size_t a, std::size_t b ) {
+                    int const c = heads[ a ].path.compare( heads[ b ].path );
+                    return c > 0 || ( c == 0 && a > b );
+                };
+                std::priority_queue<std::size_t, std::vector<std::size_t>, decltype( later )> queue{ later };
+                for ( std::size_t i = 0; i != runs.size(); ++i ) {
+                    runs[ i ]->rewind( read_buffer_size );
+                    if ( runs[ i ]->read( heads[ i ] ) ) queue.push( i );
+                }
+                while ( !queue.empty() ) {
+                    std::size_t const next = queue.top();
+                    queue.pop();
+                    visitor( heads[ next ] );
+                    if ( runs[ next ]->read( heads[ next ] ) ) queue.push( next );
+                }
+            }
+        }
+
+        external_listing_sorter::external_listing_sorter( std::size_t memory_budget, path temp_directory ) :
+            memory_budget_{ memory_budget }, temp_directory_( std::move( temp_directory ) )
+        {
+        }
+
+        external_listing_sorter::~external_listing_sorter() = default;
+
+        void external_listing_sorter::add( wchar_t const * p, std::size_t path_size, file_type type,
+            std::uintmax_t size, std::uint64_t write_time_ticks )
+        {
+            // both buffers are sized once to fit the budget between them and never grow past it, paths are longer
+            // than records on average and get the bigger share
+            if ( records_.capacity() == 0 ) {
+                text_.reserve( memory_budget_ / 4 * 3 / sizeof( wchar_t ) );
+                records_.reserve( std::max<std::size_t>( 1, memory_budget_ / 4 / sizeof( record ) ) );
+            }
+            if ( !records_.empty() && ( records_.size() == records_.capacity()
+                || text_.size() + path_size > text_.capacity() ) ) {
+                spill();
+            }
+            records_.push_back( record{ text_.size(), path_size, size, write_time_ticks, type } );
+            text_.insert( text_.end(), p, p + path_size );
+        }
+
+        void external_listing_sorter::add( directory_entry const & entry )
+        {
+            std::wstring const & p = entry.path().native();
+            file_type const type = entry.status().type();
+            FILETIME const write_time = details::ChronoTimeToWin32Filetime( entry.last_write_time() );
+            ULARGE_INTEGER ticks{};
+            ticks.LowPart = write_time.dwLowDateTime;
+            ticks.HighPart = write_time.dwHighDateTime;
+            add( p.data(), p.size(), type, type == file_type::regular ? entry.file_size() : 0, ticks.QuadPart );
+        }
+
+        void external_listing_sorter::merge( std::function<void( sorted_entry const & )> const & visitor )
+        {
+            TINYDIR_TRACE_API( external_sort );
+            if ( runs_.empty() ) { // everything fit in memory, nothing has to touch the disk
+                sort_records();
+                sorted_entry entry{};
+                for ( auto const & r : records_ ) {
+                    entry.path.assign( text_.data() + r.offset, r.path_size );
+                    entry.type = r.type;
+                    entry.size = r.size;
+                    entry.write_time_ticks = r.write_time_ticks;
+                    visitor( entry );
+                }
+                text_.clear();
+                records_.clear();
+                return;
+            }
+            if ( !records_.empty() ) spill();
+            // the budget now goes to the read buffers of the runs
+            std::vector<wchar_t>{}.swap( text_ );
+            std::vector<record>{}.swap( records_ );
+
+            std::size_t const fan_in = std::max<std::size_t>( 2, memory_budget_ / details::min_run_read_buffer );
+            std::vector<details::sort_run *> merging{};
+            while ( runs_.size() > fan_in ) {
+                auto merged = std::make_unique<details::sort_run>( temp_directory_ );
+                merging.clear();
+                for ( std::size_t i = 0; i != fan_in; ++i ) merging.push_back( runs_[ i ].get() );
+                details::merge_runs( merging, memory_budget_ / ( fan_in + 1 ), [&merged]( sorted_entry const & e ) {
+                    merged->write( e.path.data(), e.path.size(), e.type, e.size, e.write_time_ticks );
+                } );
+                merged->finish_writing();
+                runs_.erase( runs_.begin(), runs_.begin() + fan_in );
+                runs_.push_back( std::move( merged ) );
+            }
+            merging.clear();
+            for ( auto const & run : runs_ ) merging.push_back( run.get() );
+            details::merge_runs( merging, std::max( details::min_run_read_buffer, memory_budget_ / runs_.size() ),
+                visitor );
+            runs_.clear();
+        }
+
+        void external_listing_sorter::sort_records()
+        {
+            wchar_t const * const text = text_.data();
+            std::sort( records_.begin(), records_.end(), [text]( record const & a, record const & b ) {
+                int const c = std::char_traits<wchar_t>::compare( text + a.offset, text + b.offset,
+                    std::min( a.path_size, b.path_size ) );
+                return c < 0 || ( c == 0 && a.path_size < b.path_size );
+            } );
+        }
+
+        void external_listing_sorter::spill()
+        {
+            if ( temp_directory_.empty() ) temp_directory_ = temporary_directory_path();
+            sort_records();
+            auto run = std::make_unique<details::sort_run>( temp_directory_ );
+            for ( auto const & r : records_ ) {
+                run->write( text_.data() + r.offset, r.path_size, r.type, r.size, r.write_time_ticks );
+            }
+            run->finish_writing();
+            runs_.push_back( std::move( run ) );
+            ++runs_spilled_;
+            text_.clear();
+            records_.clear();
+        }
+
+        std::uint64_t sort_listing( path const & root, std::function<void( sorted_entry const & )> const & visitor,
+            std::size_t memory_budget )
+        {
+            TINYDIR_TRACE_API( external_sort );
+            external_listing_sorter sorter{ memory_budget };
+            struct context_type {
+                external_listing_sorter & sorter;
+                std::vector<std::wstring> pending;
+                std::wstring directory;
+                std::wstring child;
+                std::uint64_t count;
+            } context{ sorter, { root.native() }, {}, {}, 0 };
+            while ( !context.pending.empty() ) {
+                context.directory = std::move( context.pending.back() );
+                context.pending.pop_back();
+                if ( !context.directory.empty() && !details::is_separator( context.directory.back() ) ) {
+                    context.directory.push_back( L'\\' );
+                }
+                details::visit_directory( path{ context.directory }, []( void * c, WIN32_FIND_DATAW const & data ) {
+                    auto & ctx = *static_cast< context_type * >( c );
+                    file_type const type = details::status_from_attributes( data.dwFileAttributes,
+                        data.dwReserved0 ).type();
+                    ULARGE_INTEGER size{}, ticks{};
+                    size.LowPart = data.nFileSizeLow;
+                    size.HighPart = data.nFileSizeHigh;
+                    ticks.LowPart = data.ftLastWriteTime.dwLowDateTime;
+                    ticks.HighPart = data.ftLastWriteTime.dwHighDateTime;
+                    ctx.child.assign( ctx.directory ).append( data.cFileName );
+                    ctx.sorter.add( ctx.child.data(), ctx.child.size(), type,
+                        type == file_type::regular ? size.QuadPart : 0, ticks.QuadPart );
+                    ++ctx.count;
+                    if ( type == file_type::directory ) ctx.pending.push_back( ctx.child );
+                }, &context );
+            }
+            sorter.merge( visitor );
+            return context.count;
+        }
+
+        std::uint64_t sort_listing( path const & root, std::function<void( sorted_entry const & )> const & visitor,
+            std::size_t memory_budget, std::error_code & ec ) noexcept
+        {
+            FSERROR_TRY_CATCH( return sort_listing( root, visitor, memory_budget ), ec );
+            return 0;
+        }
+    }
+}
+
+#undef FSERROR_TRY_CATCH
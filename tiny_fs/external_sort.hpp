@@ -0,0 +1,97 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef TINYDIRCPP_EXTERNAL_SORT_HPP
+#define TINYDIRCPP_EXTERNAL_SORT_HPP
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tinydircpp.hpp"
+
+namespace tinydircpp {
+    namespace fs
+    {
+        struct sorted_entry {
+            std::wstring path;
+            file_type type = file_type::none;
+            std::uintmax_t size = 0;
+            std::uint64_t write_time_ticks = 0; // FILETIME ticks
+        };
+
+        namespace details
+        {
+            class sort_run;
+        }
+
+        // sorts entries by path, in the order of directory_entry::operator<, without ever holding more than
+        // memory_budget bytes of them. Entries are packed into two fixed buffers; when either fills, it is sorted and
+        // spilled as a run to a temporary file (deleted when closed), and merge() k-way merges the runs back.
+        // Should there be too many runs to give each a reasonable read buffer, they are merged in several passes.
+        class external_listing_sorter {
+        public:
+            explicit external_listing_sorter( std::size_t memory_budget = 64 * 1024 * 1024,
+                path temp_directory = path{} );
+            ~external_listing_sorter();
+            external_listing_sorter( external_listing_sorter const & ) = delete;
+            external_listing_sorter& operator=( external_listing_sorter const & ) = delete;
+
+            void add( wchar_t const * path, std::size_t path_size, file_type type, std::uintmax_t size,
+                std::uint64_t write_time_ticks );
+            void add( directory_entry const & entry );
+            // hands everything added so far to the visitor in sorted order, the sorter is empty afterwards
+            void merge( std::function<void( sorted_entry const & )> const & visitor );
+            std::size_t runs_spilled() const noexcept { return runs_spilled_; }
+        private:
+            struct record {
+                std::size_t offset;
+                std::size_t path_size;
+                std::uintmax_t size;
+                std::uint64_t write_time_ticks;
+                file_type type;
+            };
+
+            void sort_records();
+            void spill();
+
+            std::size_t memory_budget_;
+            path temp_directory_;
+            std::vector<wchar_t> text_;
+            std::vector<record> records_;
+            std::vector<std::unique_ptr<details::sort_run>> runs_;
+            std::size_t runs_spilled_ = 0;
+        };
+
+        // lists everything below root and visits it sorted by path, using at most about memory_budget bytes
+        std::uint64_t sort_listing( path const & root, std::function<void( sorted_entry const & )> const & visitor,
+            std::size_t memory_budget = 64 * 1024 * 1024 );
+        std::uint64_t sort_listing( path const & root, std::function<void( sorted_entry const & )> const & visitor,
+            std::size_t memory_budget, std::error_code & ec ) noexcept;
+    }
+}
+#endif
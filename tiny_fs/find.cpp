@@ -0,0 +1,389 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "find.hpp"
+#include "arena.hpp"
+#include "instrumentation.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cwctype>
+#include <exception>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace tinydircpp {
+    namespace fs {
+        namespace details
+        {
+            // '*' and '?' against an already lower-cased pattern; a '*' only ever backtracks to the latest star
+            bool glob_match( std::wstring const & pattern, wchar_t const * name ) noexcept
+            {
+                std::size_t p = 0, star = std::wstring::npos;
+                wchar_t const * n = name, *star_name = nullptr;
+                while ( *n != L'\0' ) {
+                    if ( p < pattern.size() && ( pattern[ p ] == L'?'
+                        || pattern[ p ] == static_cast< wchar_t >( std::towlower( *n ) ) ) ) {
+                        ++p;
+                        ++n;
+                    } else if ( p < pattern.size() && pattern[ p ] == L'*' ) {
+                        star = p++;
+                        star_name = n;
+                    } else if ( star != std::wstring::npos ) {
+                        p = star + 1;
+                        n = ++star_name;
+                    } else {
+                        return false;
+                    }
+                }
+                while ( p < pattern.size() && pattern[ p ] == L'*' ) ++p;
+                return p == pattern.size();
+            }
+
+            std::uint64_t to_ticks( file_time_type const & time )
+            {
+                FILETIME const ft = ChronoTimeToWin32Filetime( time );
+                ULARGE_INTEGER ticks{};
+                ticks.LowPart = ft.dwLowDateTime;
+                ticks.HighPart = ft.dwHighDateTime;
+                return ticks.QuadPart;
+            }
+        }
+
+        find_candidate::find_candidate( std::wstring const & directory, wchar_t const * name, std::size_t depth,
+            DWORD attributes, DWORD reparse_tag, std::uintmax_t size, std::uint64_t write_time_ticks ) noexcept :
+            directory_( directory ), name_{ name }, depth_{ depth }, attributes_{ attributes },
+            type_{ details::status_from_attributes( attributes, reparse_tag ).type() }, size_{ size },
+            write_time_ticks_{ write_time_ticks }
+        {
+        }
+
+        path find_candidate::path() const
+        {
+            return file_path{ directory_ + name_ };
+        }
+
+        std::uintmax_t find_candidate::hard_link_count() const
+        {
+            if ( hard_link_count_ == 0 ) hard_link_count_ = fs::hard_link_count( path() );
+            return hard_link_count_;
+        }
+
+        file_type find_candidate::target_type() const
+        {
+            if ( type_ != file_type::symlink ) return type_;
+            if ( target_type_ == file_type::none ) {
+                std::error_code ec{};
+                target_type_ = fs::status( path(), ec ).type(); // a dangling link has a not_found target
+            }
+            return target_type_;
+        }
+
+        struct find_predicate::node {
+            enum class kind { test, all, any, negation };
+
+            kind what;
+            find_cost cost;
+            test_function test;
+            std::vector<std::shared_ptr<node const>> operands;
+
+            bool operator()( find_candidate const & candidate ) const
+            {
+                switch ( what ) {
+                case kind::test:
+                    return test( candidate );
+                case kind::all:
+                    return std::all_of( operands.begin(), operands.end(), [&candidate]( auto const & n ) {
+                        return ( *n )( candidate );
+                    } );
+                case kind::any:
+                    return std::any_of( operands.begin(), operands.end(), [&candidate]( auto const & n ) {
+                        return ( *n )( candidate );
+                    } );
+                default:
+                    return !( *operands.front() )( candidate );
+                }
+            }
+
+            // a && ( b && c ) becomes one conjunction of a, b and c, sorted so the cheap tests go first
+            static std::shared_ptr<node const> combine( kind what, std::shared_ptr<node const> const & a,
+                std::shared_ptr<node const> const & b )
+            {
+                auto result = std::make_shared<node>( node{ what, find_cost::listing, {}, {} } );
+                for ( auto const & operand : { a, b } ) {
+                    if ( operand->what == what ) {
+                        result->operands.insert( result->operands.end(), operand->operands.begin(),
+                            operand->operands.end() );
+                    } else {
+                        result->operands.push_back( operand );
+                    }
+                }
+                std::stable_sort( result->operands.begin(), result->operands.end(),
+                    []( auto const & x, auto const & y ) { return x->cost < y->cost; } );
+                result->cost = result->operands.back()->cost;
+                return result;
+            }
+        };
+
+        find_predicate::find_predicate() = default;
+
+        find_predicate::find_predicate( find_cost cost, test_function test ) :
+            node_{ std::make_shared<node>( node{ node::kind::test, cost, std::move( test ), {} } ) }
+        {
+        }
+
+        bool find_predicate::operator()( find_candidate const & candidate ) const
+        {
+            return !node_ || ( *node_ )( candidate );
+        }
+
+        find_cost find_predicate::cost() const noexcept
+        {
+            return node_ ? node_->cost : find_cost::listing;
+        }
+
+        find_predicate operator&&( find_predicate const & a, find_predicate const & b )
+        {
+            if ( !a.node_ ) return b;
+            if ( !b.node_ ) return a;
+            return find_predicate{ find_predicate::node::combine( find_predicate::node::kind::all, a.node_, b.node_ ) };
+        }
+
+        find_predicate operator||( find_predicate const & a, find_predicate const & b )
+        {
+            if ( !a.node_ ) return a;
+            if ( !b.node_ ) return b;
+            return find_predicate{ find_predicate::node::combine( find_predicate::node::kind::any, a.node_, b.node_ ) };
+        }
+
+        find_predicate operator!( find_predicate const & a )
+        {
+            if ( !a.node_ ) return find_predicate{ find_cost::listing, []( find_candidate const & ) { return false; } };
+            return find_predicate{ std::make_shared<find_predicate::node>( find_predicate::node{
+                find_predicate::node::kind::negation, a.node_->cost, {}, { a.node_ } } ) };
+        }
+
+        find_predicate name_matches( std::wstring const & pattern )
+        {
+            std::wstring lowered = details::lower_case( pattern );
+            return find_predicate{ find_cost::listing, [lowered]( find_candidate const & c ) {
+                return details::glob_match( lowered, c.name() );
+            } };
+        }
+
+        find_predicate type_is( file_type type )
+        {
+            return find_predicate{ find_cost::listing, [type]( find_candidate const & c ) {
+                return c.type() == type;
+            } };
+        }
+
+        find_predicate larger_than( std::uintmax_t size )
+        {
+            return find_predicate{ find_cost::listing, [size]( find_candidate const & c ) {
+                return c.type() == file_type::regular && c.file_size() > size;
+            } };
+        }
+
+        find_predicate smaller_than( std::uintmax_t size )
+        {
+            return find_predicate{ find_cost::listing, [size]( find_candidate const & c ) {
+                return c.type() == file_type::regular && c.file_size() < size;
+            } };
+        }
+
+        find_predicate newer_than( file_time_type const & time )
+        {
+            std::uint64_t const ticks = details::to_ticks( time );
+            return find_predicate{ find_cost::listing, [ticks]( find_candidate const & c ) {
+                return c.write_time_ticks() > ticks;
+            } };
+        }
+
+        find_predicate older_than( file_time_type const & time )
+        {
+            std::uint64_t const ticks = details::to_ticks( time );
+            return find_predicate{ find_cost::listing, [ticks]( find_candidate const & c ) {
+                return c.write_time_ticks() < ticks;
+            } };
+        }
+
+        find_predicate hard_links_more_than( std::uintmax_t count )
+        {
+            return find_predicate{ find_cost::file_information, [count]( find_candidate const & c ) {
+                return c.hard_link_count() > count;
+            } };
+        }
+
+        find_predicate target_type_is( file_type type )
+        {
+            return find_predicate{ find_cost::file_information, [type]( find_candidate const & c ) {
+                return c.target_type() == type;
+            } };
+        }
+
+        namespace details
+        {
+            struct find_state {
+                find_state( find_predicate const & p, find_options const & o ) : predicate( p ), options( o ) {}
+
+                find_predicate const & predicate;
+                find_options const & options;
+
+                std::mutex queue_mutex{};
+                std::condition_variable queue_changed{};
+                std::vector<std::pair<std::wstring, std::size_t>> pending{}; // directories with their depth
+                std::size_t busy = 0; // threads listing a directory, which may add more
+                std::atomic<bool> stopped{ false };
+
+                std::mutex results_mutex{};
+                std::vector<path> results{};
+                std::exception_ptr error{};
+
+                void stop() noexcept
+                {
+                    stopped = true;
+                    std::lock_guard<std::mutex> lock{ queue_mutex };
+                    queue_changed.notify_all();
+                }
+
+                // the first error is the one find() rethrows
+                void fail( std::exception_ptr failure ) noexcept
+                {
+                    {
+                        std::lock_guard<std::mutex> lock{ results_mutex };
+                        if ( !error ) error = std::move( failure );
+                    }
+                    stop();
+                }
+
+                void add_result( find_candidate const & candidate )
+                {
+                    path found = candidate.path();
+                    std::lock_guard<std::mutex> lock{ results_mutex };
+                    if ( options.max_results != 0 && results.size() >= options.max_results ) return;
+                    results.push_back( std::move( found ) );
+                    if ( options.max_results != 0 && results.size() == options.max_results ) stop();
+                }
+            };
+
+            struct find_listing {
+                find_state & state;
+                std::wstring const & directory;
+                std::size_t depth; // of the directory being listed, the root's is 0
+                std::vector<std::pair<std::wstring, std::size_t>> & subdirectories;
+            };
+
+            void find_in_directory( void * context, WIN32_FIND_DATAW const & data )
+            {
+                auto & listing = *static_cast< find_listing * >( context );
+                if ( listing.state.stopped ) return;
+                ULARGE_INTEGER size{}, ticks{};
+                size.LowPart = data.nFileSizeLow;
+                size.HighPart = data.nFileSizeHigh;
+                ticks.LowPart = data.ftLastWriteTime.dwLowDateTime;
+                ticks.HighPart = data.ftLastWriteTime.dwHighDateTime;
+                std::size_t const depth = listing.depth + 1;
+                find_candidate const candidate{ listing.directory, data.cFileName, depth, data.dwFileAttributes,
+                    data.dwReserved0, size.QuadPart, ticks.QuadPart };
+                // a predicate that throws ends the search, the error must not pass for one listing the directory
+                try {
+                    if ( listing.state.predicate( candidate ) ) listing.state.add_result( candidate );
+                } catch ( ... ) {
+                    listing.state.fail( std::current_exception() );
+                    return;
+                }
+                if ( candidate.type() == file_type::directory && depth < listing.state.options.max_depth ) {
+                    listing.subdirectories.emplace_back( listing.directory + data.cFileName + L'\\', depth );
+                }
+            }
+
+            // takes directories off the shared queue until it is empty with nobody left to refill it
+            void find_worker( find_state & state )
+            {
+                std::vector<std::pair<std::wstring, std::size_t>> subdirectories{};
+                for ( ;; ) {
+                    std::pair<std::wstring, std::size_t> directory{};
+                    {
+                        std::unique_lock<std::mutex> lock{ state.queue_mutex };
+                        state.queue_changed.wait( lock, [&state] {
+                            return state.stopped || !state.pending.empty() || state.busy == 0;
+                        } );
+                        if ( state.stopped || state.pending.empty() ) return;
+                        directory = std::move( state.pending.back() );
+                        state.pending.pop_back();
+                        ++state.busy;
+                    }
+                    subdirectories.clear();
+                    try {
+                        find_listing listing{ state, directory.first, directory.second, subdirectories };
+                        visit_directory( path{ directory.first }, find_in_directory, &listing );
+                    } catch ( fs::filesystem_error const & ) { // only the listing itself throws here
+                        bool const is_root = directory.second == 0;
+                        if ( is_root || !state.options.skip_unreadable ) state.fail( std::current_exception() );
+                    } catch ( ... ) {
+                        state.fail( std::current_exception() );
+                    }
+                    std::lock_guard<std::mutex> lock{ state.queue_mutex };
+                    --state.busy;
+                    std::move( subdirectories.begin(), subdirectories.end(), std::back_inserter( state.pending ) );
+                    state.queue_changed.notify_all();
+                }
+            }
+        }
+
+        std::vector<path> find( path const & root, find_predicate const & predicate, find_options const & options )
+        {
+            TINYDIR_TRACE_API( find );
+            details::find_state state{ predicate, options };
+            std::wstring directory = root.native();
+            if ( !directory.empty() && !details::is_separator( directory.back() ) ) directory.push_back( L'\\' );
+            state.pending.emplace_back( std::move( directory ), 0 );
+
+            std::size_t thread_count = options.thread_count;
+            if ( thread_count == 0 ) thread_count = ( std::max )( 1u, std::thread::hardware_concurrency() );
+            std::vector<std::thread> threads{};
+            for ( std::size_t i = 1; i < thread_count; ++i ) {
+                threads.emplace_back( details::find_worker, std::ref( state ) );
+            }
+            details::find_worker( state );
+            for ( auto & t : threads ) t.join();
+
+            if ( state.error ) std::rethrow_exception( state.error );
+            return std::move( state.results );
+        }
+
+        std::vector<path> find( path const & root, find_predicate const & predicate, find_options const & options,
+            std::error_code & ec ) noexcept
+        {
+            FSERROR_TRY_CATCH( return find( root, predicate, options ), ec );
+            return {};
+        }
+    }
+}
+
+#undef FSERROR_TRY_CATCH
@@ -0,0 +1,128 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef TINYDIRCPP_FIND_HPP
+#define TINYDIRCPP_FIND_HPP
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tinydircpp.hpp"
+
+namespace tinydircpp {
+    namespace fs
+    {
+        // what a predicate needs to look at. Unlike readdir's d_type, a FindFirstFileEx listing brings type, size,
+        // attributes and write time along with the name, so only the link count and the type of a symlink's target
+        // cost system calls of their own.
+        enum class find_cost : int {
+            listing = 0,
+            file_information
+        };
+
+        // one entry of the walk as seen by predicates. Whatever costs a system call is fetched on first use only.
+        class find_candidate {
+            using file_path = path;
+        public:
+            find_candidate( std::wstring const & directory, wchar_t const * name, std::size_t depth,
+                DWORD attributes, DWORD reparse_tag, std::uintmax_t size, std::uint64_t write_time_ticks ) noexcept;
+
+            wchar_t const * name() const noexcept { return name_; }
+            std::size_t depth() const noexcept { return depth_; }
+            file_type type() const noexcept { return type_; }
+            DWORD attributes() const noexcept { return attributes_; }
+            std::uintmax_t file_size() const noexcept { return size_; }
+            std::uint64_t write_time_ticks() const noexcept { return write_time_ticks_; }
+            file_path path() const;
+
+            std::uintmax_t hard_link_count() const;
+            // the type of what a symlink points to, an entry's own type otherwise
+            file_type target_type() const;
+        private:
+            std::wstring const & directory_;
+            wchar_t const * name_;
+            std::size_t depth_;
+            DWORD attributes_;
+            file_type type_;
+            std::uintmax_t size_;
+            std::uint64_t write_time_ticks_;
+            mutable std::uintmax_t hard_link_count_ = 0;
+            mutable file_type target_type_ = file_type::none;
+        };
+
+        // a test of candidates, composable with &&, || and !. The operands of && and || are reordered cheapest first,
+        // so a candidate ruled out by its name or size is never opened to count its links.
+        class find_predicate {
+        public:
+            using test_function = std::function<bool( find_candidate const & )>;
+
+            find_predicate(); // accepts everything
+            find_predicate( find_cost cost, test_function test );
+
+            bool operator()( find_candidate const & candidate ) const;
+            find_cost cost() const noexcept;
+
+            friend find_predicate operator&&( find_predicate const & a, find_predicate const & b );
+            friend find_predicate operator||( find_predicate const & a, find_predicate const & b );
+            friend find_predicate operator!( find_predicate const & a );
+        private:
+            struct node;
+            explicit find_predicate( std::shared_ptr<node const> n ) : node_{ std::move( n ) } {}
+            std::shared_ptr<node const> node_;
+        };
+
+        // case-insensitive, '*' matches any run of characters and '?' any single one
+        find_predicate name_matches( std::wstring const & pattern );
+        find_predicate type_is( file_type type );
+        find_predicate larger_than( std::uintmax_t size );
+        find_predicate smaller_than( std::uintmax_t size );
+        find_predicate newer_than( file_time_type const & time );
+        find_predicate older_than( file_time_type const & time );
+        find_predicate hard_links_more_than( std::uintmax_t count );
+        find_predicate target_type_is( file_type type );
+
+        struct find_options {
+            // children of the root are at depth 1, nothing deeper than this is listed
+            std::size_t max_depth = ( std::numeric_limits<std::size_t>::max )( );
+            // stop the walk once this many matches are found, 0 for no limit
+            std::size_t max_results = 0;
+            std::size_t thread_count = 0; // 0 for one thread per core
+            // directories that cannot be listed are skipped instead of failing the search; the root must be
+            bool skip_unreadable = true;
+        };
+
+        // walks root with a pool of threads taking directories off a shared queue and returns the paths of the
+        // entries accepted by predicate, in the order they were found. Symlinks are not followed.
+        std::vector<path> find( path const & root, find_predicate const & predicate,
+            find_options const & options = find_options{} );
+        std::vector<path> find( path const & root, find_predicate const & predicate, find_options const & options,
+            std::error_code & ec ) noexcept;
+    }
+}
+#endif
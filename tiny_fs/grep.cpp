@@ -0,0 +1,196 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "grep.hpp"
+#include "instrumentation.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace tinydircpp {
+    namespace fs {
+        namespace details
+        {
+            constexpr std::size_t grep_chunk_size = 1024 * 1024;
+
+            void grep_file( path const & file, literal_matcher const & matcher, grep_options const & options,
+                std::vector<char> & buffer, std::vector<grep_hit> & hits )
+            {
+                smart_handle handle{ TINYDIR_SYSCALL( create_file, CreateFileW( file.c_str(), GENERIC_READ,
+                    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                    FILE_FLAG_SEQUENTIAL_SCAN, nullptr ) ) };
+                if ( !handle ) {
+                    if ( options.skip_unreadable ) return;
+                    FSTHROW_MANUAL( fs::filesystem_error_codes::handle_not_opened, file );
+                }
+                literal_matcher::state_type state = 0;
+                std::uint64_t offset = 0;
+                std::size_t found = 0;
+                auto const on_match = [&]( std::size_t literal, std::uint64_t at ) {
+                    hits.push_back( grep_hit{ file, at, literal } );
+                    return options.max_hits_per_file == 0 || ++found < options.max_hits_per_file;
+                };
+                for ( ;; ) {
+                    DWORD read = 0;
+                    if ( !TINYDIR_SYSCALL( read_file, ReadFile( handle, buffer.data(),
+                        static_cast< DWORD >( buffer.size() ), &read, nullptr ) ) ) {
+                        if ( options.skip_unreadable ) return;
+                        FSTHROW_MANUAL( fs::filesystem_error_codes::unknown_io_error, file );
+                    }
+                    if ( read == 0 ) return;
+                    TINYDIR_COUNT_BYTES( grep, read );
+                    if ( !matcher.scan( buffer.data(), read, offset, state, on_match ) ) return;
+                    offset += read;
+                }
+            }
+        }
+
+        literal_matcher::literal_matcher( std::vector<std::string> literals ) : literals_( std::move( literals ) )
+        {
+            if ( literals_.empty() || std::any_of( literals_.begin(), literals_.end(),
+                []( std::string const & l ) { return l.empty(); } ) ) {
+                throw fs::filesystem_error{ "there must be literals to search for, none of them empty",
+                    std::make_error_code( std::errc::invalid_argument ) };
+            }
+            // the trie first, where 0 marks a missing edge since nothing leads back to the root
+            transitions_.assign( 256, 0 );
+            outputs_.emplace_back();
+            for ( std::size_t index = 0; index != literals_.size(); ++index ) {
+                state_type current = 0;
+                for ( char const c : literals_[ index ] ) {
+                    std::size_t const edge = current * 256 + static_cast< unsigned char >( c );
+                    if ( transitions_[ edge ] == 0 ) {
+                        transitions_[ edge ] = static_cast< state_type >( outputs_.size() );
+                        transitions_.resize( transitions_.size() + 256, 0 );
+                        outputs_.emplace_back();
+                    }
+                    current = transitions_[ edge ];
+                }
+                outputs_[ current ].push_back( static_cast< std::uint32_t >( index ) );
+                unsigned char const first = static_cast< unsigned char >( literals_[ index ].front() );
+                if ( !starts_[ first ] ) {
+                    starts_[ first ] = true;
+                    only_start_ = first;
+                    ++start_count_;
+                }
+            }
+            // then, breadth first, the failure links are folded into the table: a missing edge leads where the
+            // longest suffix that is also a prefix of some literal would go, and a state reports the literals of its
+            // failure state too
+            std::vector<state_type> failure( outputs_.size(), 0 ), queue{};
+            for ( std::size_t c = 0; c != 256; ++c ) {
+                if ( transitions_[ c ] != 0 ) queue.push_back( transitions_[ c ] );
+            }
+            for ( std::size_t next = 0; next != queue.size(); ++next ) {
+                state_type const current = queue[ next ];
+                for ( std::size_t c = 0; c != 256; ++c ) {
+                    state_type & target = transitions_[ current * 256 + c ];
+                    state_type const fallback = transitions_[ failure[ current ] * 256 + c ];
+                    if ( target == 0 ) {
+                        target = fallback;
+                    } else {
+                        failure[ target ] = fallback;
+                        outputs_[ target ].insert( outputs_[ target ].end(), outputs_[ fallback ].begin(),
+                            outputs_[ fallback ].end() );
+                        queue.push_back( target );
+                    }
+                }
+            }
+        }
+
+        std::size_t literal_matcher::skip( char const * data, std::size_t size, std::size_t from ) const noexcept
+        {
+            if ( start_count_ == 1 ) { // the C runtime's memchr is vectorized
+                void const * const found = std::memchr( data + from, only_start_, size - from );
+                return found ? static_cast< char const * >( found ) - data : size;
+            }
+            while ( from != size && !starts_[ static_cast< unsigned char >( data[ from ] ) ] ) ++from;
+            return from;
+        }
+
+        std::vector<grep_hit> grep( path const & root, std::vector<std::string> const & literals,
+            grep_options const & options )
+        {
+            TINYDIR_TRACE_API( grep );
+            literal_matcher const matcher{ literals };
+            find_options walk{};
+            walk.max_depth = options.max_depth;
+            walk.thread_count = options.thread_count;
+            walk.skip_unreadable = options.skip_unreadable;
+            std::vector<path> const files = fs::find( root, type_is( file_type::regular ) && options.files, walk );
+
+            std::atomic<std::size_t> next_file{ 0 };
+            std::atomic<bool> failed{ false };
+            std::mutex results_mutex{};
+            std::vector<grep_hit> results{};
+            std::exception_ptr error{};
+            auto const worker = [&] {
+                std::vector<char> buffer( details::grep_chunk_size );
+                std::vector<grep_hit> hits{};
+                try {
+                    for ( std::size_t i = next_file++; !failed && i < files.size(); i = next_file++ ) {
+                        details::grep_file( files[ i ], matcher, options, buffer, hits );
+                    }
+                } catch ( ... ) {
+                    std::lock_guard<std::mutex> lock{ results_mutex };
+                    if ( !error ) error = std::current_exception();
+                    failed = true;
+                }
+                std::lock_guard<std::mutex> lock{ results_mutex };
+                std::move( hits.begin(), hits.end(), std::back_inserter( results ) );
+            };
+
+            std::size_t thread_count = options.thread_count;
+            if ( thread_count == 0 ) thread_count = ( std::max )( 1u, std::thread::hardware_concurrency() );
+            thread_count = ( std::min )( thread_count, ( std::max )( std::size_t{ 1 }, files.size() ) );
+            std::vector<std::thread> threads{};
+            for ( std::size_t i = 1; i < thread_count; ++i ) threads.emplace_back( worker );
+            worker();
+            for ( auto & t : threads ) t.join();
+            if ( error ) std::rethrow_exception( error );
+
+            std::sort( results.begin(), results.end(), []( grep_hit const & a, grep_hit const & b ) {
+                int const c = a.file.native().compare( b.file.native() );
+                if ( c != 0 ) return c < 0;
+                return a.offset < b.offset || ( a.offset == b.offset && a.literal < b.literal );
+            } );
+            return results;
+        }
+
+        std::vector<grep_hit> grep( path const & root, std::vector<std::string> const & literals,
+            grep_options const & options, std::error_code & ec ) noexcept
+        {
+            FSERROR_TRY_CATCH( return grep( root, literals, options ), ec );
+            return {};
+        }
+    }
+}
+
+#undef FSERROR_TRY_CATCH
@@ -0,0 +1,113 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef TINYDIRCPP_GREP_HPP
+#define TINYDIRCPP_GREP_HPP
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "find.hpp"
+
+namespace tinydircpp {
+    namespace fs
+    {
+        // finds any number of byte literals in one pass: an Aho-Corasick automaton compiled to a full transition
+        // table, so scanning costs one lookup per byte whatever the number of literals. While no literal is under
+        // way it skips ahead to the next byte that can start one, with memchr when there is a single such byte.
+        // The state carries over between calls, a literal split across two chunks of a file is still found.
+        class literal_matcher {
+        public:
+            using state_type = std::uint32_t;
+
+            explicit literal_matcher( std::vector<std::string> literals );
+
+            std::size_t literal_count() const noexcept { return literals_.size(); }
+            std::string const & literal( std::size_t index ) const { return literals_[ index ]; }
+
+            // calls on_match( literal index, offset of the literal's first byte ) for every occurrence, offsets
+            // counting from base; stops and returns false as soon as on_match does
+            template<typename Visitor>
+            bool scan( char const * data, std::size_t size, std::uint64_t base, state_type & state,
+                Visitor && on_match ) const;
+        private:
+            std::size_t skip( char const * data, std::size_t size, std::size_t from ) const noexcept;
+
+            std::vector<std::string> literals_;
+            std::vector<state_type> transitions_; // 256 per state
+            std::vector<std::vector<std::uint32_t>> outputs_; // literals ending in each state
+            bool starts_[ 256 ] = {}; // bytes a literal starts with
+            std::size_t start_count_ = 0;
+            unsigned char only_start_ = 0;
+        };
+
+        struct grep_hit {
+            path file;
+            std::uint64_t offset; // of the literal's first byte
+            std::size_t literal; // index into the literals searched for
+        };
+
+        struct grep_options {
+            // files searched, only regular ones are ever read
+            find_predicate files{};
+            std::size_t max_depth = ( std::numeric_limits<std::size_t>::max )( );
+            std::size_t max_hits_per_file = 0; // 0 for no limit
+            std::size_t thread_count = 0; // 0 for one thread per core
+            // files and directories that cannot be read are skipped instead of failing the search
+            bool skip_unreadable = true;
+        };
+
+        // finds the files below root with fs::find, then spreads them over a pool of threads that read each in
+        // large sequential chunks and run them through one literal_matcher. Hits are sorted by path and offset.
+        std::vector<grep_hit> grep( path const & root, std::vector<std::string> const & literals,
+            grep_options const & options = grep_options{} );
+        std::vector<grep_hit> grep( path const & root, std::vector<std::string> const & literals,
+            grep_options const & options, std::error_code & ec ) noexcept;
+
+        template<typename Visitor>
+        bool literal_matcher::scan( char const * data, std::size_t size, std::uint64_t base, state_type & state,
+            Visitor && on_match ) const
+        {
+            std::size_t i = 0;
+            while ( i < size ) {
+                if ( state == 0 ) {
+                    i = skip( data, size, i );
+                    if ( i == size ) break;
+                }
+                state = transitions_[ state * 256 + static_cast< unsigned char >( data[ i ] ) ];
+                ++i;
+                for ( std::uint32_t const literal : outputs_[ state ] ) {
+                    if ( !on_match( static_cast< std::size_t >( literal ), base + i - literals_[ literal ].size() ) ) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+    }
+}
+#endif
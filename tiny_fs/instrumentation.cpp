@@ -0,0 +1,242 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "instrumentation.hpp"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace tinydircpp {
+    namespace fs {
+        namespace instrumentation
+        {
+            std::size_t latency_histogram::bucket_index( std::uint64_t nanoseconds ) noexcept
+            {
+                if ( nanoseconds < 2 * sub_buckets ) return static_cast< std::size_t >( nanoseconds );
+                std::size_t magnitude = 0; // position of the highest set bit
+                for ( std::uint64_t v = nanoseconds; v >>= 1; ) ++magnitude;
+                if ( magnitude >= max_magnitude ) return bucket_count - 1;
+                std::size_t const shift = magnitude - 4;
+                return shift * sub_buckets + static_cast< std::size_t >( nanoseconds >> shift );
+            }
+
+            std::uint64_t latency_histogram::bucket_lower_bound( std::size_t index ) noexcept
+            {
+                if ( index < 2 * sub_buckets ) return index;
+                std::size_t const shift = index / sub_buckets - 1;
+                return static_cast< std::uint64_t >( index % sub_buckets + sub_buckets ) << shift;
+            }
+
+            std::uint64_t latency_histogram::count() const noexcept
+            {
+                std::uint64_t total = 0;
+                for ( auto const c : buckets ) total += c;
+                return total;
+            }
+
+            std::uint64_t latency_histogram::percentile( double p ) const noexcept
+            {
+                std::uint64_t const total = count();
+                if ( total == 0 ) return 0;
+                auto const wanted = static_cast< std::uint64_t >( ( p / 100.0 ) * ( total - 1 ) ) + 1;
+                std::uint64_t seen = 0;
+                for ( std::size_t i = 0; i != bucket_count; ++i ) {
+                    seen += buckets[ i ];
+                    if ( seen >= wanted ) return bucket_lower_bound( i );
+                }
+                return bucket_lower_bound( bucket_count - 1 );
+            }
+
+            char const * to_string( api a ) noexcept
+            {
+                static char const * const names[ api_count ] = { "status", "exists", "file_size", "equivalent", "copy",
+                    "hard_link_count", "last_write_time", "set_last_write_time", "last_access_time",
+                    "set_last_access_time", "creation_time", "set_creation_time", "create_directory",
+                    "create_directories", "read_symlink", "resize_file", "space", "directory_iteration", "scandir",
+                    "status_cache", "read_file", "bulk_create_directories", "list_directory", "realpath", "sync_tree",
+                    "write_listing", "external_sort", "find", "grep", "rename", "sync", "atomic_write", "permissions",
+                    "apply_permissions", "xattrs", "file_times", "volume", "snapshot", "directory_lookup",
+                    "temporary_files", "unattributed" };
+                auto const index = static_cast< std::size_t >( a );
+                return index < api_count ? names[ index ] : "";
+            }
+
+            char const * to_string( syscall s ) noexcept
+            {
+                static char const * const names[ syscall_count ] = { "get_file_attributes", "find_first_file",
+                    "find_next_file", "create_file", "get_file_information", "get_file_size", "copy_file",
+                    "create_directory", "create_link", "set_file_time", "device_io_control", "set_file_pointer",
+                    "get_disk_free_space", "get_full_path_name", "get_temp_path", "current_directory",
+                    "read_directory_changes", "read_file", "completion_port", "remove", "write_file", "move_file",
+                    "flush_file_buffers", "set_file_attributes", "security_info", "volume_information",
+                    "set_file_information", "get_file_time" };
+                auto const index = static_cast< std::size_t >( s );
+                return index < syscall_count ? names[ index ] : "";
+            }
+
+            namespace details
+            {
+                using counter = std::atomic<std::uint64_t>;
+
+                // written only by the owning thread, read by collect() from any thread; relaxed ordering is
+                // enough since a snapshot doesn't have to be consistent across counters
+                struct thread_counters {
+                    counter calls[ api_count ];
+                    counter bytes[ api_count ];
+                    counter latency[ api_count ][ latency_histogram::bucket_count ];
+                    counter api_syscalls[ api_count ][ syscall_count ];
+                };
+
+                void bump( counter & c, std::uint64_t by = 1 ) noexcept
+                {
+                    c.store( c.load( std::memory_order_relaxed ) + by, std::memory_order_relaxed );
+                }
+
+                void add_to( statistics & stats, thread_counters const & counters ) noexcept
+                {
+                    for ( std::size_t a = 0; a != api_count; ++a ) {
+                        auto & api_stats = stats.apis[ a ];
+                        api_stats.calls += counters.calls[ a ].load( std::memory_order_relaxed );
+                        api_stats.bytes += counters.bytes[ a ].load( std::memory_order_relaxed );
+                        for ( std::size_t b = 0; b != latency_histogram::bucket_count; ++b ) {
+                            api_stats.latency.buckets[ b ] +=
+                                counters.latency[ a ][ b ].load( std::memory_order_relaxed );
+                        }
+                        for ( std::size_t s = 0; s != syscall_count; ++s ) {
+                            auto const n = counters.api_syscalls[ a ][ s ].load( std::memory_order_relaxed );
+                            api_stats.syscalls[ s ] += n;
+                            stats.syscalls[ s ] += n;
+                        }
+                    }
+                }
+
+                void clear( thread_counters & counters ) noexcept
+                {
+                    for ( std::size_t a = 0; a != api_count; ++a ) {
+                        counters.calls[ a ].store( 0, std::memory_order_relaxed );
+                        counters.bytes[ a ].store( 0, std::memory_order_relaxed );
+                        for ( auto & c : counters.latency[ a ] ) c.store( 0, std::memory_order_relaxed );
+                        for ( auto & c : counters.api_syscalls[ a ] ) c.store( 0, std::memory_order_relaxed );
+                    }
+                }
+
+                struct registry {
+                    std::mutex mutex{};
+                    std::vector<thread_counters *> live{};
+                    statistics retired{}; // totals of threads that have exited
+                };
+
+                registry & global_registry()
+                {
+                    static registry r{};
+                    return r;
+                }
+
+                class thread_slot {
+                public:
+                    thread_slot() : counters_{ new thread_counters{} }
+                    {
+                        auto & r = global_registry();
+                        std::lock_guard<std::mutex> lock{ r.mutex };
+                        r.live.push_back( counters_.get() );
+                    }
+                    ~thread_slot()
+                    {
+                        auto & r = global_registry();
+                        std::lock_guard<std::mutex> lock{ r.mutex };
+                        add_to( r.retired, *counters_ );
+                        r.live.erase( std::find( r.live.begin(), r.live.end(), counters_.get() ) );
+                    }
+                    thread_counters & counters() noexcept { return *counters_; }
+
+                    api current = api::unattributed; // outermost traced function running on this thread
+                private:
+                    std::unique_ptr<thread_counters> counters_;
+                };
+
+                thread_slot & local_slot()
+                {
+                    thread_local thread_slot slot{};
+                    return slot;
+                }
+
+                void count_syscall( syscall s ) noexcept
+                {
+                    auto & slot = local_slot();
+                    bump( slot.counters().api_syscalls[ static_cast< std::size_t >( slot.current ) ]
+                        [ static_cast< std::size_t >( s ) ] );
+                }
+
+                void count_bytes( api a, std::uint64_t bytes ) noexcept
+                {
+                    bump( local_slot().counters().bytes[ static_cast< std::size_t >( a ) ], bytes );
+                }
+
+                api_scope::api_scope( api a ) noexcept : api_{ a },
+                    outermost_{ local_slot().current == api::unattributed },
+                    start_{ std::chrono::steady_clock::now() }
+                {
+                    if ( outermost_ ) local_slot().current = a;
+                }
+
+                api_scope::~api_scope()
+                {
+                    auto const elapsed = std::chrono::duration_cast< std::chrono::nanoseconds >(
+                        std::chrono::steady_clock::now() - start_ ).count();
+                    auto & slot = local_slot();
+                    auto const index = static_cast< std::size_t >( api_ );
+                    bump( slot.counters().calls[ index ] );
+                    bump( slot.counters().latency[ index ][ latency_histogram::bucket_index(
+                        static_cast< std::uint64_t >( elapsed ) ) ] );
+                    if ( outermost_ ) slot.current = api::unattributed;
+                }
+            }
+
+            statistics collect()
+            {
+                statistics stats{};
+#ifdef TINYDIRCPP_INSTRUMENTATION
+                auto & r = details::global_registry();
+                std::lock_guard<std::mutex> lock{ r.mutex };
+                stats = r.retired;
+                for ( auto const counters : r.live ) details::add_to( stats, *counters );
+#endif
+                return stats;
+            }
+
+            void reset() noexcept
+            {
+#ifdef TINYDIRCPP_INSTRUMENTATION
+                auto & r = details::global_registry();
+                std::lock_guard<std::mutex> lock{ r.mutex };
+                r.retired = statistics{};
+                for ( auto const counters : r.live ) details::clear( *counters );
+#endif
+            }
+        }
+    }
+}
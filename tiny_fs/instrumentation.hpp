@@ -0,0 +1,204 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef TINYDIRCPP_INSTRUMENTATION_HPP
+#define TINYDIRCPP_INSTRUMENTATION_HPP
+
+// Opt-in counters for what the library does under load. Define TINYDIRCPP_INSTRUMENTATION when building tiny_fs
+// to turn them on; without it the TINYDIR_* hooks below expand to nothing (or to the bare system call) and
+// collect() always returns an empty set of statistics.
+//
+// Every thread counts into its own block of counters, collect() sums the blocks of all live threads together
+// with whatever threads that have already exited left behind.
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace tinydircpp {
+    namespace fs {
+        namespace instrumentation
+        {
+            enum class api : int {
+                status,
+                exists,
+                file_size,
+                equivalent,
+                copy,
+                hard_link_count,
+                last_write_time,
+                set_last_write_time,
+                last_access_time,
+                set_last_access_time,
+                creation_time,
+                set_creation_time,
+                create_directory,
+                create_directories,
+                read_symlink,
+                resize_file,
+                space,
+                directory_iteration,
+                scandir,
+                status_cache,
+                read_file,
+                bulk_create_directories,
+                list_directory,
+                realpath,
+                sync_tree,
+                write_listing,
+                external_sort,
+                find,
+                grep,
+                rename,
+                sync,
+                atomic_write,
+                permissions,
+                apply_permissions,
+                xattrs,
+                file_times,
+                volume,
+                snapshot,
+                directory_lookup,
+                temporary_files,
+                unattributed, // system calls made outside of any traced function
+                count
+            };
+
+            enum class syscall : int {
+                get_file_attributes,
+                find_first_file,
+                find_next_file,
+                create_file,
+                get_file_information,
+                get_file_size,
+                copy_file,
+                create_directory,
+                create_link,
+                set_file_time,
+                device_io_control,
+                set_file_pointer,
+                get_disk_free_space,
+                get_full_path_name,
+                get_temp_path,
+                current_directory,
+                read_directory_changes,
+                read_file,
+                completion_port,
+                remove,
+                write_file,
+                move_file,
+                flush_file_buffers,
+                set_file_attributes,
+                security_info,
+                volume_information,
+                set_file_information,
+                get_file_time,
+                count
+            };
+
+            constexpr std::size_t api_count = static_cast< std::size_t >( api::count );
+            constexpr std::size_t syscall_count = static_cast< std::size_t >( syscall::count );
+
+            // log-linear buckets in the spirit of HdrHistogram: exact below 32ns, then 16 buckets per power of two
+            // (about 6% relative error) up to 2^40ns, anything slower lands in the last bucket
+            class latency_histogram {
+            public:
+                static constexpr std::size_t sub_buckets = 16;
+                static constexpr std::size_t max_magnitude = 40;
+                static constexpr std::size_t bucket_count = ( max_magnitude - 3 ) * sub_buckets;
+
+                static std::size_t bucket_index( std::uint64_t nanoseconds ) noexcept;
+                static std::uint64_t bucket_lower_bound( std::size_t index ) noexcept;
+
+                void record( std::uint64_t nanoseconds ) noexcept { ++buckets[ bucket_index( nanoseconds ) ]; }
+                std::uint64_t count() const noexcept;
+                // lower bound of the bucket holding the given percentile (0-100), 0 when nothing was recorded
+                std::uint64_t percentile( double p ) const noexcept;
+
+                std::array<std::uint64_t, bucket_count> buckets{};
+            };
+
+            struct api_statistics {
+                std::uint64_t calls = 0;
+                std::uint64_t bytes = 0;
+                latency_histogram latency{};
+                // system calls made while this was the outermost traced function on the calling thread
+                std::array<std::uint64_t, syscall_count> syscalls{};
+            };
+
+            struct statistics {
+                std::array<api_statistics, api_count> apis{};
+                std::array<std::uint64_t, syscall_count> syscalls{};
+            };
+
+            constexpr bool enabled() noexcept
+            {
+#ifdef TINYDIRCPP_INSTRUMENTATION
+                return true;
+#else
+                return false;
+#endif
+            }
+
+            statistics collect();
+            void reset() noexcept;
+            char const * to_string( api a ) noexcept;
+            char const * to_string( syscall s ) noexcept;
+
+            namespace details
+            {
+                void count_syscall( syscall s ) noexcept;
+                void count_bytes( api a, std::uint64_t bytes ) noexcept;
+
+                class api_scope {
+                public:
+                    explicit api_scope( api a ) noexcept;
+                    ~api_scope();
+                    api_scope( api_scope const & ) = delete;
+                    api_scope& operator=( api_scope const & ) = delete;
+                private:
+                    api const api_;
+                    bool const outermost_;
+                    std::chrono::steady_clock::time_point const start_;
+                };
+            }
+        }
+    }
+}
+
+#ifdef TINYDIRCPP_INSTRUMENTATION
+#define TINYDIR_TRACE_API(name) ::tinydircpp::fs::instrumentation::details::api_scope const \
+    tinydir_api_scope_{ ::tinydircpp::fs::instrumentation::api::name }
+#define TINYDIR_SYSCALL(name, ...) ( ::tinydircpp::fs::instrumentation::details::count_syscall( \
+    ::tinydircpp::fs::instrumentation::syscall::name ), __VA_ARGS__ )
+#define TINYDIR_COUNT_BYTES(name, bytes) ::tinydircpp::fs::instrumentation::details::count_bytes( \
+    ::tinydircpp::fs::instrumentation::api::name, static_cast< std::uint64_t >( bytes ) )
+#else
+#define TINYDIR_TRACE_API(name) ( void )0
+#define TINYDIR_SYSCALL(name, ...) ( __VA_ARGS__ )
+#define TINYDIR_COUNT_BYTES(name, bytes) ( void )0
+#endif
+
+#endif
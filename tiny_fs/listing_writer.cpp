@@ -0,0 +1,278 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "listing_writer.hpp"
+#include "arena.hpp"
+#include "instrumentation.hpp"
+#include <cstdio>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <utility>
+
+namespace tinydircpp {
+    namespace fs {
+        namespace details
+        {
+            std::uint64_t zigzag( std::uint64_t delta ) noexcept
+            {
+                auto const signed_delta = static_cast< std::int64_t >( delta );
+                return ( delta << 1 ) ^ static_cast< std::uint64_t >( signed_delta >> 63 );
+            }
+
+            std::uint64_t unzigzag( std::uint64_t value ) noexcept
+            {
+                return ( value >> 1 ) ^ ( ~( value & 1 ) + 1 );
+            }
+
+            char const * type_name( file_type type ) noexcept
+            {
+                switch ( type ) {
+                case file_type::not_found: return "not_found";
+                case file_type::regular: return "regular";
+                case file_type::directory: return "directory";
+                case file_type::symlink: return "symlink";
+                case file_type::block: return "block";
+                case file_type::character: return "character";
+                case file_type::fifo: return "fifo";
+                case file_type::socket: return "socket";
+                case file_type::unknown: return "unknown";
+                default: return "none";
+                }
+            }
+
+            [[noreturn]] void throw_listing_error( char const * what, std::errc code )
+            {
+                throw fs::filesystem_error{ what, std::make_error_code( code ) };
+            }
+        }
+
+        listing_writer::listing_writer( std::ostream & out, listing_format format, std::size_t buffer_size ) :
+            out_( out ), format_{ format }, buffer_size_{ buffer_size }
+        {
+            buffer_.reserve( buffer_size_ + 1024 );
+            if ( format_ == listing_format::binary ) put_text( "TDL1" );
+        }
+
+        listing_writer::~listing_writer()
+        {
+            try {
+                flush();
+            } catch ( fs::filesystem_error const & ) {
+            }
+        }
+
+        std::uint64_t listing_writer::write( std::uint64_t parent_id, wchar_t const * name, std::size_t name_size,
+            file_type type, std::uint64_t size, std::uint64_t write_time_ticks )
+        {
+            // the name buffer is reused from record to record, converting a name allocates nothing once it is big
+            // enough for the longest name seen
+            int const utf8_size = name_size == 0 ? 0 : WideCharToMultiByte( CP_UTF8, 0, name,
+                static_cast< int >( name_size ), nullptr, 0, nullptr, nullptr );
+            utf8_name_.resize( static_cast< std::size_t >( utf8_size ) );
+            if ( utf8_size != 0 ) {
+                WideCharToMultiByte( CP_UTF8, 0, name, static_cast< int >( name_size ), &utf8_name_[ 0 ], utf8_size,
+                    nullptr, nullptr );
+            }
+
+            ++last_id_;
+            if ( format_ == listing_format::binary ) {
+                reserve( 4 * 10 + 1 + utf8_name_.size() );
+                put_varint( details::zigzag( parent_id - previous_parent_ ) );
+                buffer_.push_back( static_cast< char >( static_cast< int >( type ) ) );
+                put_varint( utf8_name_.size() );
+                buffer_.insert( buffer_.end(), utf8_name_.begin(), utf8_name_.end() );
+                put_varint( size );
+                put_varint( details::zigzag( write_time_ticks - previous_time_ ) );
+                previous_parent_ = parent_id;
+                previous_time_ = write_time_ticks;
+            } else {
+                char number[ 96 ];
+                std::snprintf( number, sizeof( number ), "{\"id\":%llu,\"parent\":%llu,\"name\":",
+                    static_cast< unsigned long long >( last_id_ ), static_cast< unsigned long long >( parent_id ) );
+                put_text( number );
+                put_json_string( utf8_name_.data(), utf8_name_.size() );
+                put_text( ",\"type\":\"" );
+                put_text( details::type_name( type ) );
+                std::uint64_t const epoch = static_cast< std::uint64_t >( details::unix_epoch_ticks );
+                bool const before_epoch = write_time_ticks < epoch;
+                std::uint64_t const ticks = before_epoch ? epoch - write_time_ticks : write_time_ticks - epoch;
+                std::snprintf( number, sizeof( number ), "\",\"size\":%llu,\"mtime\":%s%llu.%07llu}\n",
+                    static_cast< unsigned long long >( size ), before_epoch ? "-" : "",
+                    static_cast< unsigned long long >( ticks / 10000000 ),
+                    static_cast< unsigned long long >( ticks % 10000000 ) );
+                put_text( number );
+            }
+            if ( buffer_.size() >= buffer_size_ ) flush();
+            return last_id_;
+        }
+
+        std::uint64_t listing_writer::write( std::uint64_t parent_id, directory_entry const & entry )
+        {
+            path_component const name = entry.path().filename_component();
+            file_type const type = entry.status().type();
+            FILETIME const write_time = details::ChronoTimeToWin32Filetime( entry.last_write_time() );
+            ULARGE_INTEGER ticks{};
+            ticks.LowPart = write_time.dwLowDateTime;
+            ticks.HighPart = write_time.dwHighDateTime;
+            return write( parent_id, name.data(), name.size(), type,
+                type == file_type::regular ? entry.file_size() : 0, ticks.QuadPart );
+        }
+
+        void listing_writer::flush()
+        {
+            if ( buffer_.empty() ) return;
+            out_.write( buffer_.data(), static_cast< std::streamsize >( buffer_.size() ) );
+            TINYDIR_COUNT_BYTES( write_listing, buffer_.size() );
+            buffer_.clear();
+            if ( !out_ ) details::throw_listing_error( "writing the listing failed", std::errc::io_error );
+        }
+
+        void listing_writer::put_varint( std::uint64_t value )
+        {
+            while ( value >= 0x80 ) {
+                buffer_.push_back( static_cast< char >( ( value & 0x7F ) | 0x80 ) );
+                value >>= 7;
+            }
+            buffer_.push_back( static_cast< char >( value ) );
+        }
+
+        void listing_writer::put_text( char const * text )
+        {
+            buffer_.insert( buffer_.end(), text, text + std::strlen( text ) );
+        }
+
+        void listing_writer::put_json_string( char const * text, std::size_t size )
+        {
+            buffer_.push_back( '"' );
+            for ( std::size_t i = 0; i != size; ++i ) {
+                unsigned char const c = static_cast< unsigned char >( text[ i ] );
+                if ( c == '"' || c == '\\' ) {
+                    buffer_.push_back( '\\' );
+                    buffer_.push_back( static_cast< char >( c ) );
+                } else if ( c < 0x20 ) { // names may hold control characters, JSON strings may not
+                    char escaped[ 8 ];
+                    std::snprintf( escaped, sizeof( escaped ), "\\u%04x", c );
+                    put_text( escaped );
+                } else {
+                    buffer_.push_back( static_cast< char >( c ) );
+                }
+            }
+            buffer_.push_back( '"' );
+        }
+
+        void listing_writer::reserve( std::size_t bytes )
+        {
+            if ( buffer_.capacity() - buffer_.size() < bytes ) buffer_.reserve( buffer_.size() + bytes );
+        }
+
+        binary_listing_reader::binary_listing_reader( std::istream & in ) : in_( in )
+        {
+            char magic[ 4 ] = {};
+            in_.read( magic, sizeof( magic ) );
+            if ( in_.gcount() != sizeof( magic ) || std::memcmp( magic, "TDL1", sizeof( magic ) ) != 0 ) {
+                details::throw_listing_error( "not a binary listing", std::errc::invalid_argument );
+            }
+        }
+
+        bool binary_listing_reader::next( listing_record & record )
+        {
+            std::uint64_t parent_delta = 0, name_size = 0, time_delta = 0;
+            if ( !get_varint( parent_delta ) ) return false; // the listing may only end between records
+            int const type = in_.get();
+            if ( type == std::char_traits<char>::eof() || !get_varint( name_size ) ) {
+                details::throw_listing_error( "binary listing cut short", std::errc::io_error );
+            }
+            record.name.resize( static_cast< std::size_t >( name_size ) );
+            if ( name_size != 0 ) in_.read( &record.name[ 0 ], static_cast< std::streamsize >( name_size ) );
+            if ( static_cast< std::uint64_t >( in_.gcount() ) != name_size || !get_varint( record.size )
+                || !get_varint( time_delta ) ) {
+                details::throw_listing_error( "binary listing cut short", std::errc::io_error );
+            }
+            record.id = ++last_id_;
+            record.parent_id = previous_parent_ += details::unzigzag( parent_delta );
+            record.type = static_cast< file_type >( static_cast< signed char >( type ) );
+            record.write_time_ticks = previous_time_ += details::unzigzag( time_delta );
+            return true;
+        }
+
+        bool binary_listing_reader::get_varint( std::uint64_t & value )
+        {
+            value = 0;
+            for ( unsigned shift = 0; shift < 64; shift += 7 ) {
+                int const c = in_.get();
+                if ( c == std::char_traits<char>::eof() ) return false;
+                value |= static_cast< std::uint64_t >( c & 0x7F ) << shift;
+                if ( ( c & 0x80 ) == 0 ) return true;
+            }
+            details::throw_listing_error( "binary listing holds an overlong number", std::errc::invalid_argument );
+        }
+
+        std::uint64_t write_listing( path const & root, listing_writer & writer )
+        {
+            TINYDIR_TRACE_API( write_listing );
+            std::uint64_t const already_written = writer.records_written();
+            // directories still to be listed, with the ids their entries will name as parent
+            std::vector<std::pair<std::wstring, std::uint64_t>> pending{ { root.native(), 0 } };
+            while ( !pending.empty() ) {
+                auto const directory = std::move( pending.back() );
+                pending.pop_back();
+                struct context_type {
+                    listing_writer & writer;
+                    std::vector<std::pair<std::wstring, std::uint64_t>> & pending;
+                    std::pair<std::wstring, std::uint64_t> const & directory;
+                } context{ writer, pending, directory };
+                details::visit_directory( path{ directory.first }, []( void * c, WIN32_FIND_DATAW const & data ) {
+                    auto & ctx = *static_cast< context_type * >( c );
+                    file_type const type = details::status_from_attributes( data.dwFileAttributes,
+                        data.dwReserved0 ).type();
+                    ULARGE_INTEGER size{}, ticks{};
+                    size.LowPart = data.nFileSizeLow;
+                    size.HighPart = data.nFileSizeHigh;
+                    ticks.LowPart = data.ftLastWriteTime.dwLowDateTime;
+                    ticks.HighPart = data.ftLastWriteTime.dwHighDateTime;
+                    std::size_t const name_size = std::char_traits<wchar_t>::length( data.cFileName );
+                    std::uint64_t const id = ctx.writer.write( ctx.directory.second, data.cFileName, name_size, type,
+                        type == file_type::regular ? size.QuadPart : 0, ticks.QuadPart );
+                    if ( type == file_type::directory ) {
+                        std::wstring child = ctx.directory.first;
+                        if ( !child.empty() && !details::is_separator( child.back() ) ) child.push_back( L'\\' );
+                        child.append( data.cFileName, name_size );
+                        ctx.pending.emplace_back( std::move( child ), id );
+                    }
+                }, &context );
+            }
+            return writer.records_written() - already_written;
+        }
+
+        std::uint64_t write_listing( path const & root, listing_writer & writer, std::error_code & ec ) noexcept
+        {
+            FSERROR_TRY_CATCH( return write_listing( root, writer ), ec );
+            return 0;
+        }
+    }
+}
+
+#undef FSERROR_TRY_CATCH
@@ -0,0 +1,111 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef TINYDIRCPP_LISTING_WRITER_HPP
+#define TINYDIRCPP_LISTING_WRITER_HPP
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "tinydircpp.hpp"
+
+namespace tinydircpp {
+    namespace fs
+    {
+        enum class listing_format : int {
+            // "TDL1", then one record per entry: varint zigzag(parent id - previous parent id), type byte,
+            // varint name length, UTF-8 name, varint size, varint zigzag(write time - previous write time).
+            // Ids number the records from 1 in the order they are written, 0 is the root of the listing.
+            // Times are FILETIME ticks.
+            binary,
+            // one {"id":..,"parent":..,"name":"..","type":"..","size":..,"mtime":..} object per line, mtime in
+            // seconds since 1970
+            ndjson
+        };
+
+        // writes listing records into out through a buffer of its own, every record is written as it arrives
+        // so a listing of any length takes the same memory
+        class listing_writer {
+        public:
+            listing_writer( std::ostream & out, listing_format format, std::size_t buffer_size = 64 * 1024 );
+            ~listing_writer(); // flushes, but cannot report errors: call flush() first to see them
+            listing_writer( listing_writer const & ) = delete;
+            listing_writer& operator=( listing_writer const & ) = delete;
+
+            // returns the id of the record written
+            std::uint64_t write( std::uint64_t parent_id, wchar_t const * name, std::size_t name_size, file_type type,
+                std::uint64_t size, std::uint64_t write_time_ticks );
+            std::uint64_t write( std::uint64_t parent_id, directory_entry const & entry );
+            void flush();
+            std::uint64_t records_written() const noexcept { return last_id_; }
+        private:
+            void put_varint( std::uint64_t value );
+            void put_text( char const * text );
+            void put_json_string( char const * text, std::size_t size );
+            void reserve( std::size_t bytes );
+
+            std::ostream & out_;
+            listing_format const format_;
+            std::size_t const buffer_size_;
+            std::vector<char> buffer_{};
+            std::string utf8_name_{};
+            std::uint64_t last_id_ = 0;
+            std::uint64_t previous_parent_ = 0;
+            std::uint64_t previous_time_ = 0;
+        };
+
+        struct listing_record {
+            std::uint64_t id = 0;
+            std::uint64_t parent_id = 0;
+            std::string name{}; // UTF-8
+            file_type type = file_type::none;
+            std::uint64_t size = 0;
+            std::uint64_t write_time_ticks = 0;
+        };
+
+        // reads back what a listing_writer wrote in listing_format::binary
+        class binary_listing_reader {
+        public:
+            explicit binary_listing_reader( std::istream & in );
+            // false at the end of the listing; throws on a listing cut short or not in this format
+            bool next( listing_record & record );
+        private:
+            bool get_varint( std::uint64_t & value );
+
+            std::istream & in_;
+            std::uint64_t last_id_ = 0;
+            std::uint64_t previous_parent_ = 0;
+            std::uint64_t previous_time_ = 0;
+        };
+
+        // writes every entry below root, depth first, straight from the directory listings. Memory use depends
+        // on the number of directories still waiting to be listed, not on the number of entries.
+        std::uint64_t write_listing( path const & root, listing_writer & writer );
+        std::uint64_t write_listing( path const & root, listing_writer & writer, std::error_code & ec ) noexcept;
+    }
+}
+#endif
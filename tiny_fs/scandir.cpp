@@ -0,0 +1,169 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "scandir.hpp"
+#include "instrumentation.hpp"
+#include <algorithm>
+#include <numeric>
+#include <utility>
+
+namespace tinydircpp {
+    namespace fs {
+
+        path scandir_entry::path() const
+        {
+            return details::child_path( *directory_, name_, name_size_ );
+        }
+
+        file_time_type scandir_entry::last_write_time() const
+        {
+            ULARGE_INTEGER ticks{};
+            ticks.QuadPart = write_time_;
+            return details::Win32FiletimeToChronoTime( FILETIME{ ticks.LowPart, ticks.HighPart } );
+        }
+
+        namespace details
+        {
+            std::uint64_t type_rank( file_type type ) noexcept
+            {
+                switch ( type ) {
+                case file_type::directory: return 0;
+                case file_type::symlink: return 1;
+                case file_type::regular: return 2;
+                default: return 3;
+                }
+            }
+
+            // the first `count` UTF-16 units of a name packed so that comparing two keys as integers orders them
+            // like comparing the names, most comparisons are settled without touching the name arena at all
+            std::uint64_t name_prefix_key( scandir_entry const & entry, std::size_t count ) noexcept
+            {
+                std::uint64_t key = 0;
+                for ( std::size_t i = 0; i != count; ++i ) {
+                    key <<= 16;
+                    if ( i < entry.name_size() ) key |= static_cast< std::uint16_t >( entry.name()[ i ] );
+                }
+                return key;
+            }
+
+            std::uint64_t sort_key_of( scandir_entry const & entry, scandir_sort sort_key ) noexcept
+            {
+                switch ( sort_key ) {
+                case scandir_sort::inode: return entry.inode();
+                case scandir_sort::type: return ( type_rank( entry.type() ) << 48 ) | name_prefix_key( entry, 3 );
+                default: return name_prefix_key( entry, 4 );
+                }
+            }
+
+            void sort_entries( std::vector<scandir_entry> & entries, scandir_sort sort_key )
+            {
+                if ( sort_key == scandir_sort::none || entries.size() < 2 ) return;
+
+                std::vector<std::pair<std::uint64_t, std::uint32_t>> keys( entries.size() );
+                for ( std::uint32_t i = 0; i != entries.size(); ++i ) {
+                    keys[ i ] = { sort_key_of( entries[ i ], sort_key ), i };
+                }
+                std::sort( keys.begin(), keys.end(), [&entries]( std::pair<std::uint64_t, std::uint32_t> const & a,
+                    std::pair<std::uint64_t, std::uint32_t> const & b ) {
+                    if ( a.first != b.first ) return a.first < b.first;
+                    return std::wcscmp( entries[ a.second ].name(), entries[ b.second ].name() ) < 0;
+                } );
+                std::vector<scandir_entry> sorted{};
+                sorted.reserve( entries.size() );
+                for ( auto const & key : keys ) sorted.push_back( entries[ key.second ] );
+                entries.swap( sorted );
+            }
+        }
+
+        scandir_result scandir( path const & p, scandir_filter filter, scandir_sort sort_key )
+        {
+            TINYDIR_TRACE_API( scandir );
+            details::smart_handle directory_handle{ TINYDIR_SYSCALL( create_file, CreateFileW( p.c_str(),
+                FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                FILE_FLAG_BACKUP_SEMANTICS, nullptr ) ) };
+            if ( !directory_handle ) {
+                FSTHROW_MANUAL( fs::filesystem_error_codes::handle_not_opened, p );
+            }
+
+            scandir_result result{};
+            result.directory_ = std::make_shared<path const>( p );
+            std::vector<std::size_t> name_offsets{};
+
+            // a single request returns as many entries as fit in the buffer, names, ids and times included
+            std::vector<unsigned long long> buffer( ( 64 * 1024 ) / sizeof( unsigned long long ) );
+            while ( TINYDIR_SYSCALL( get_file_information, GetFileInformationByHandleEx( directory_handle,
+                FileIdBothDirectoryInfo, buffer.data(),
+                static_cast< DWORD >( buffer.size() * sizeof( unsigned long long ) ) ) ) != 0 ) {
+                char const * cursor = reinterpret_cast< char const * >( buffer.data() );
+                for ( ;; ) {
+                    auto const & info = *reinterpret_cast< FILE_ID_BOTH_DIR_INFO const * >( cursor );
+                    std::size_t const name_size = info.FileNameLength / sizeof( wchar_t );
+                    bool const is_dot = ( name_size == 1 && info.FileName[ 0 ] == L'.' )
+                        || ( name_size == 2 && info.FileName[ 0 ] == L'.' && info.FileName[ 1 ] == L'.' );
+                    if ( !is_dot ) {
+                        std::size_t const offset = result.names_.size();
+                        result.names_.insert( result.names_.end(), info.FileName, info.FileName + name_size );
+                        result.names_.push_back( L'\0' );
+
+                        scandir_entry entry{};
+                        entry.name_ = result.names_.data() + offset; // re-pointed once the arena stops growing
+                        entry.name_size_ = static_cast< std::uint32_t >( name_size );
+                        entry.directory_ = result.directory_.get();
+                        entry.inode_ = static_cast< std::uint64_t >( info.FileId.QuadPart );
+                        entry.file_size_ = static_cast< std::uint64_t >( info.EndOfFile.QuadPart );
+                        entry.write_time_ = static_cast< std::uint64_t >( info.LastWriteTime.QuadPart );
+                        // for reparse points EaSize holds the reparse tag
+                        entry.type_ = details::status_from_attributes( info.FileAttributes, info.EaSize ).type();
+                        if ( !filter || filter( entry ) ) {
+                            result.entries_.push_back( entry );
+                            name_offsets.push_back( offset );
+                        } else {
+                            result.names_.resize( offset );
+                        }
+                    }
+                    if ( info.NextEntryOffset == 0 ) break;
+                    cursor += info.NextEntryOffset;
+                }
+            }
+            if ( GetLastError() != ERROR_NO_MORE_FILES ) {
+                FSTHROW_MANUAL( fs::filesystem_error_codes::unknown_io_error, p );
+            }
+            for ( std::size_t i = 0; i != result.entries_.size(); ++i ) {
+                result.entries_[ i ].name_ = result.names_.data() + name_offsets[ i ];
+            }
+            details::sort_entries( result.entries_, sort_key );
+            return result;
+        }
+
+        scandir_result scandir( path const & p, std::error_code & ec, scandir_filter filter,
+            scandir_sort sort_key ) noexcept
+        {
+            FSERROR_TRY_CATCH( return scandir( p, std::move( filter ), sort_key ), ec );
+            return scandir_result{};
+        }
+    }
+}
+
+#undef FSERROR_TRY_CATCH
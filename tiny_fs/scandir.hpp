@@ -0,0 +1,112 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef TINYDIRCPP_SCANDIR_HPP
+#define TINYDIRCPP_SCANDIR_HPP
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "tinydircpp.hpp"
+
+namespace tinydircpp {
+    namespace fs
+    {
+        enum class scandir_sort : int {
+            none = 0,
+            name,
+            inode,
+            type // directories first, then symlinks, regular files and everything else; by name within a type
+        };
+
+        class scandir_result;
+
+        // a compact record of one directory entry as returned by the listing itself. The name lives in the
+        // owning scandir_result's name arena, so an entry is only valid for as long as its result is.
+        class scandir_entry {
+            using file_path = path;
+        public:
+            wchar_t const * name() const noexcept { return name_; }
+            std::size_t name_size() const noexcept { return name_size_; }
+            file_path path() const;
+            std::uint64_t inode() const noexcept { return inode_; }
+            file_type type() const noexcept { return type_; }
+            bool is_dir() const noexcept { return type_ == file_type::directory; }
+            bool is_file() const noexcept { return type_ == file_type::regular; }
+            bool is_symlink() const noexcept { return type_ == file_type::symlink; }
+            std::uintmax_t file_size() const noexcept { return file_size_; }
+            file_time_type last_write_time() const;
+        private:
+            friend class scandir_result;
+            friend scandir_result scandir( file_path const &, std::function<bool( scandir_entry const & )>,
+                scandir_sort );
+
+            wchar_t const * name_ = nullptr;
+            file_path const * directory_ = nullptr;
+            std::uint64_t inode_ = 0;
+            std::uint64_t file_size_ = 0;
+            std::uint64_t write_time_ = 0; // raw FILETIME ticks, converted on demand
+            std::uint32_t name_size_ = 0;
+            file_type type_ = file_type::none;
+        };
+
+        using scandir_filter = std::function<bool( scandir_entry const & )>;
+
+        class scandir_result {
+        public:
+            using const_iterator = std::vector<scandir_entry>::const_iterator;
+
+            scandir_result() = default;
+            scandir_result( scandir_result && ) = default;
+            scandir_result& operator=( scandir_result && ) = default;
+            // entries point into names_, a copy would have them pointing into somebody else's arena
+            scandir_result( scandir_result const & ) = delete;
+            scandir_result& operator=( scandir_result const & ) = delete;
+
+            path const & directory() const { return *directory_; }
+            std::size_t size() const noexcept { return entries_.size(); }
+            bool empty() const noexcept { return entries_.empty(); }
+            scandir_entry const & operator[]( std::size_t index ) const { return entries_[ index ]; }
+            const_iterator begin() const noexcept { return entries_.cbegin(); }
+            const_iterator end() const noexcept { return entries_.cend(); }
+        private:
+            friend scandir_result scandir( path const &, scandir_filter, scandir_sort );
+
+            std::shared_ptr<path const> directory_{};
+            std::vector<wchar_t> names_{};
+            std::vector<scandir_entry> entries_{};
+        };
+
+        // reads the whole directory in a few large requests, keeps the entries accepted by filter (all of them
+        // when filter is empty) and sorts them by sort_key. "." and ".." are never returned.
+        scandir_result scandir( path const & p, scandir_filter filter = scandir_filter{},
+            scandir_sort sort_key = scandir_sort::name );
+        scandir_result scandir( path const & p, std::error_code & ec, scandir_filter filter = scandir_filter{},
+            scandir_sort sort_key = scandir_sort::name ) noexcept;
+    }
+}
+#endif
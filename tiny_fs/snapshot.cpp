@@ -0,0 +1,200 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "snapshot.hpp"
+#include "instrumentation.hpp"
+#include "scandir.hpp"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace tinydircpp {
+    namespace fs {
+        namespace details
+        {
+            constexpr std::uint32_t no_link = static_cast< std::uint32_t >( -1 );
+
+            // entries are opened themselves, links included: a link's id is its own, not its target's. The root is
+            // followed, its listing is the target's
+            bool file_information_of( path const & p, BY_HANDLE_FILE_INFORMATION & information, bool follow_link )
+            {
+                DWORD const flags = follow_link ? FILE_FLAG_BACKUP_SEMANTICS
+                    : FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OPEN_REPARSE_POINT;
+                smart_handle file{ TINYDIR_SYSCALL( create_file, CreateFileW( p.c_str(), 0,
+                    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, flags,
+                    nullptr ) ) };
+                return file && TINYDIR_SYSCALL( get_file_information, GetFileInformationByHandle( file,
+                    &information ) ) != 0;
+            }
+        }
+
+        snapshot_entry const * tree_snapshot::find( path const & p ) const
+        {
+            auto const found = by_path_.find( details::lower_case( p.native() ) );
+            return found == by_path_.end() ? nullptr : &entries_[ found->second ];
+        }
+
+        std::vector<path> tree_snapshot::links_of( path const & p ) const
+        {
+            std::vector<path> links{};
+            snapshot_entry const * const entry = find( p );
+            if ( !entry ) return links;
+            if ( entry->identity.file_id == 0 ) return std::vector<path>{ entry->entry_path };
+            for ( std::uint32_t i = first_link_.at( entry->identity ); i != details::no_link; i = next_link_[ i ] ) {
+                links.push_back( entries_[ i ].entry_path );
+            }
+            return links;
+        }
+
+        bool tree_snapshot::equivalent( path const & a, path const & b ) const
+        {
+            snapshot_entry const * const a_entry = find( a );
+            snapshot_entry const * const b_entry = find( b );
+            return a_entry && b_entry && ( a_entry == b_entry
+                || ( a_entry->identity.file_id != 0 && a_entry->identity == b_entry->identity ) );
+        }
+
+        std::vector<std::vector<std::size_t>> tree_snapshot::hard_link_groups() const
+        {
+            std::vector<std::vector<std::size_t>> groups{};
+            for ( auto const & link : first_link_ ) {
+                if ( next_link_[ link.second ] == details::no_link ) continue;
+                groups.emplace_back();
+                for ( std::uint32_t i = link.second; i != details::no_link; i = next_link_[ i ] ) {
+                    groups.back().push_back( i );
+                }
+                std::sort( groups.back().begin(), groups.back().end() );
+            }
+            std::sort( groups.begin(), groups.end() );
+            return groups;
+        }
+
+        tree_snapshot snapshot_tree( path const & root, snapshot_options const & options )
+        {
+            TINYDIR_TRACE_API( snapshot );
+            BY_HANDLE_FILE_INFORMATION root_information{};
+            if ( !details::file_information_of( root, root_information, true ) ) {
+                FSTHROW_MANUAL( fs::filesystem_error_codes::handle_not_opened, root );
+            }
+            tree_snapshot snapshot{};
+            auto & entries = snapshot.entries_;
+            {
+                snapshot_entry entry{};
+                entry.entry_path = root;
+                entry.identity.volume = root_information.dwVolumeSerialNumber;
+                entry.identity.file_id = ( std::uint64_t{ root_information.nFileIndexHigh } << 32 )
+                    | root_information.nFileIndexLow;
+                entry.type = details::status_from_attributes( root_information.dwFileAttributes, 0 ).type();
+                entry.size = ( std::uintmax_t{ root_information.nFileSizeHigh } << 32 ) | root_information.nFileSizeLow;
+                entry.last_write_time = details::Win32FiletimeToChronoTime( root_information.ftLastWriteTime );
+                entry.link_count = options.link_counts ? root_information.nNumberOfLinks : 0;
+                entries.push_back( std::move( entry ) );
+            }
+
+            // the listing doesn't cross into other volumes, reparse points are never followed, so the root's
+            // volume serial number holds for every entry. File ids come with the listing, an entry is only opened
+            // when the file system left its id out.
+            for ( std::size_t directory = 0; directory != entries.size(); ++directory ) {
+                if ( entries[ directory ].type != file_type::directory ) continue;
+                path const directory_path = entries[ directory ].entry_path;
+                std::error_code ec{};
+                scandir_result const listing = options.skip_unreadable
+                    ? scandir( directory_path, ec, scandir_filter{}, scandir_sort::none )
+                    : scandir( directory_path, scandir_filter{}, scandir_sort::none );
+                for ( auto const & listed : listing ) {
+                    snapshot_entry entry{};
+                    entry.entry_path = details::child_path( directory_path, listed.name(), listed.name_size() );
+                    entry.identity.volume = root_information.dwVolumeSerialNumber;
+                    entry.identity.file_id = listed.inode();
+                    entry.type = listed.type();
+                    entry.size = listed.file_size();
+                    entry.last_write_time = listed.last_write_time();
+                    entries.push_back( std::move( entry ) );
+                }
+            }
+
+            bool const ids_missing = std::any_of( entries.begin() + 1, entries.end(), []( snapshot_entry const & e ) {
+                return e.identity.file_id == 0;
+            } );
+            if ( options.link_counts || ids_missing ) {
+                std::size_t thread_count = options.thread_count != 0 ? options.thread_count
+                    : ( std::max )( 1u, std::thread::hardware_concurrency() );
+                thread_count = ( std::min )( thread_count, entries.size() );
+                std::atomic<std::size_t> next_entry{ 1 };
+                bool const link_counts = options.link_counts;
+                auto const counter = [&entries, &next_entry, link_counts] {
+                    BY_HANDLE_FILE_INFORMATION information{};
+                    for ( std::size_t i = next_entry++; i < entries.size(); i = next_entry++ ) {
+                        auto & entry = entries[ i ];
+                        bool const count = link_counts && entry.type == file_type::regular;
+                        if ( ( !count && entry.identity.file_id != 0 )
+                            || !details::file_information_of( entry.entry_path, information, false ) ) {
+                            continue;
+                        }
+                        if ( count ) entry.link_count = information.nNumberOfLinks;
+                        // still 0 when the handle doesn't know either, the entry stays unknown then
+                        if ( entry.identity.file_id == 0 ) {
+                            entry.identity.file_id = ( std::uint64_t{ information.nFileIndexHigh } << 32 )
+                                | information.nFileIndexLow;
+                        }
+                    }
+                };
+                std::vector<std::thread> threads{};
+                for ( std::size_t i = 1; i < thread_count; ++i ) threads.emplace_back( counter );
+                counter();
+                for ( auto & t : threads ) t.join();
+            }
+
+            snapshot.next_link_.assign( entries.size(), details::no_link );
+            snapshot.by_path_.reserve( entries.size() );
+            for ( std::uint32_t i = 0; i != entries.size(); ++i ) {
+                snapshot.by_path_.emplace( details::lower_case( entries[ i ].entry_path.native() ), i );
+                if ( entries[ i ].identity.file_id == 0 ) continue;
+                auto const inserted = snapshot.first_link_.emplace( entries[ i ].identity, i );
+                if ( !inserted.second ) {
+                    snapshot.next_link_[ i ] = inserted.first->second;
+                    inserted.first->second = i;
+                }
+            }
+            for ( auto const & link : snapshot.first_link_ ) {
+                std::uint32_t links = 0;
+                for ( std::uint32_t i = link.second; i != details::no_link; i = snapshot.next_link_[ i ] ) ++links;
+                for ( std::uint32_t i = link.second; i != details::no_link; i = snapshot.next_link_[ i ] ) {
+                    entries[ i ].links_in_tree = links;
+                }
+            }
+            return snapshot;
+        }
+
+        tree_snapshot snapshot_tree( path const & root, snapshot_options const & options,
+            std::error_code & ec ) noexcept
+        {
+            FSERROR_TRY_CATCH( return snapshot_tree( root, options ), ec );
+            return tree_snapshot{};
+        }
+    }
+}
+
+#undef FSERROR_TRY_CATCH
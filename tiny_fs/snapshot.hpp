@@ -0,0 +1,122 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef TINYDIRCPP_SNAPSHOT_HPP
+#define TINYDIRCPP_SNAPSHOT_HPP
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "tinydircpp.hpp"
+
+namespace tinydircpp {
+    namespace fs
+    {
+        // what makes two paths the same file: the volume's serial number and the file's id on it, as compared by
+        // equivalent(). A file_id of 0 is unknown, such an entry is only ever equivalent to itself
+        struct file_identity {
+            std::uint32_t volume = 0;
+            std::uint64_t file_id = 0;
+        };
+
+        inline bool operator==( file_identity const & a, file_identity const & b ) noexcept
+        {
+            return a.volume == b.volume && a.file_id == b.file_id;
+        }
+
+        inline bool operator!=( file_identity const & a, file_identity const & b ) noexcept
+        {
+            return !( a == b );
+        }
+
+        struct file_identity_hash {
+            std::size_t operator()( file_identity const & identity ) const noexcept
+            {
+                return std::hash<std::uint64_t>{}( identity.file_id ^ ( std::uint64_t{ identity.volume } << 32 ) );
+            }
+        };
+
+        struct snapshot_entry {
+            path entry_path;
+            file_identity identity;
+            file_type type = file_type::none;
+            std::uintmax_t size = 0;
+            file_time_type last_write_time{};
+            // paths in the snapshot that share identity, this one included
+            std::uint32_t links_in_tree = 1;
+            // the file's own link count, which also counts links outside the tree. Only filled in for regular
+            // files when snapshot_options::link_counts is set, 0 otherwise.
+            std::uint32_t link_count = 0;
+        };
+
+        struct snapshot_options {
+            // opens every regular file for its link count; without it only the links inside the tree are known,
+            // which comes free with the listing
+            bool link_counts = false;
+            // threads used for the link counts, 0 picks one per core
+            std::size_t thread_count = 0;
+            // a directory that can't be listed is left out instead of failing the snapshot
+            bool skip_unreadable = true;
+        };
+
+        // root and everything below it, with the identity of every entry taken from the directory listings
+        // themselves and indexed both ways: from path to entry, and from identity to all paths of that file.
+        // Symbolic links and junctions are recorded but not followed.
+        // Paths are looked up by their spelling (case aside), the way the snapshot reached them from root.
+        class tree_snapshot {
+        public:
+            tree_snapshot() = default;
+
+            std::vector<snapshot_entry> const & entries() const noexcept { return entries_; }
+            std::size_t size() const noexcept { return entries_.size(); }
+
+            // null when p is not in the snapshot
+            snapshot_entry const * find( path const & p ) const;
+            // every path of the file p is, p included; empty when p is not in the snapshot
+            std::vector<path> links_of( path const & p ) const;
+            // false when either path is not in the snapshot
+            bool equivalent( path const & a, path const & b ) const;
+            // the files reached by more than one path, each as the indices of its entries
+            std::vector<std::vector<std::size_t>> hard_link_groups() const;
+        private:
+            friend tree_snapshot snapshot_tree( path const & root, snapshot_options const & options );
+
+            std::vector<snapshot_entry> entries_{};
+            // the entries sharing an identity form a chain through next_link_, first_link_ holds its head. Entries
+            // of unknown identity are in no chain
+            std::vector<std::uint32_t> next_link_{};
+            std::unordered_map<file_identity, std::uint32_t, file_identity_hash> first_link_{};
+            std::unordered_map<std::wstring, std::uint32_t> by_path_{};
+        };
+
+        tree_snapshot snapshot_tree( path const & root, snapshot_options const & options = snapshot_options{} );
+        tree_snapshot snapshot_tree( path const & root, snapshot_options const & options,
+            std::error_code & ec ) noexcept;
+    }
+}
+#endif
@@ -0,0 +1,350 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "status_cache.hpp"
+#include "instrumentation.hpp"
+#include <algorithm>
+#include <cwctype>
+#include <functional>
+#include <thread>
+
+namespace tinydircpp {
+    namespace fs {
+        namespace details
+        {
+            // Windows names are case insensitive and take either separator, the key spells them one way only
+            std::wstring cache_key( wchar_t const * first, wchar_t const * last )
+            {
+                std::wstring key( first, last );
+                for ( auto & c : key ) c = c == L'/' ? L'\\' : static_cast< wchar_t >( std::towlower( c ) );
+                while ( key.size() > 1 && key.back() == L'\\' && key[ key.size() - 2 ] != L':' ) key.pop_back();
+                return key;
+            }
+
+            std::wstring cache_key( path const & p )
+            {
+                std::wstring const & name = p.native();
+                return cache_key( name.data(), name.data() + name.size() );
+            }
+
+            class directory_watcher {
+            public:
+                directory_watcher( status_cache & cache, path const & directory ) :
+                    cache_( cache ), root_( cache_key( directory ) ),
+                    directory_handle_{ TINYDIR_SYSCALL( create_file, CreateFileW( directory.c_str(),
+                        FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                        OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr ) ) },
+                    stop_event_{ CreateEventW( nullptr, TRUE, FALSE, nullptr ) },
+                    io_event_{ CreateEventW( nullptr, TRUE, FALSE, nullptr ) }
+                {
+                    if ( !directory_handle_ ) {
+                        FSTHROW_MANUAL( fs::filesystem_error_codes::handle_not_opened, directory );
+                    }
+                    if ( stop_event_ == nullptr || io_event_ == nullptr ) {
+                        FSTHROW_MANUAL( fs::filesystem_error_codes::unknown_io_error, directory );
+                    }
+                    thread_ = std::thread{ &directory_watcher::run, this };
+                }
+
+                ~directory_watcher()
+                {
+                    SetEvent( stop_event_ );
+                    if ( thread_.joinable() ) thread_.join();
+                    CloseHandle( io_event_ );
+                    CloseHandle( stop_event_ );
+                }
+            private:
+                void run()
+                {
+                    DWORD const filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME
+                        | FILE_NOTIFY_CHANGE_ATTRIBUTES | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE;
+                    std::vector<DWORD> buffer( ( 64 * 1024 ) / sizeof( DWORD ) );
+                    HANDLE const events[] = { stop_event_, io_event_ };
+                    for ( ;; ) {
+                        OVERLAPPED overlapped{};
+                        overlapped.hEvent = io_event_;
+                        ResetEvent( io_event_ );
+                        if ( TINYDIR_SYSCALL( read_directory_changes, ReadDirectoryChangesW( directory_handle_,
+                            buffer.data(), static_cast< DWORD >( buffer.size() * sizeof( DWORD ) ), TRUE, filter,
+                            nullptr, &overlapped, nullptr ) ) == 0 ) {
+                            // nobody is listening any more, nothing cached from here on could be trusted
+                            cache_.watcher_failed_ = true;
+                            cache_.clear();
+                            return;
+                        }
+                        DWORD transferred = 0;
+                        if ( WaitForMultipleObjects( 2, events, FALSE, INFINITE ) != WAIT_OBJECT_0 + 1 ) {
+                            CancelIoEx( directory_handle_, &overlapped );
+                            GetOverlappedResult( directory_handle_, &overlapped, &transferred, TRUE );
+                            return;
+                        }
+                        // zero bytes means the system's own buffer overflowed and the changes are lost
+                        if ( GetOverlappedResult( directory_handle_, &overlapped, &transferred, FALSE ) == 0
+                            || transferred == 0 ) {
+                            cache_.clear();
+                            continue;
+                        }
+                        process( reinterpret_cast< char const * >( buffer.data() ) );
+                    }
+                }
+
+                void process( char const * cursor )
+                {
+                    for ( ;; ) {
+                        auto const & info = *reinterpret_cast< FILE_NOTIFY_INFORMATION const * >( cursor );
+                        std::wstring key = root_;
+                        if ( key.back() != L'\\' ) key.push_back( L'\\' ); // a drive root has its separator already
+                        key += cache_key( info.FileName, info.FileName + info.FileNameLength / sizeof( wchar_t ) );
+                        cache_.invalidate_key( key, info.Action == FILE_ACTION_REMOVED
+                            || info.Action == FILE_ACTION_RENAMED_OLD_NAME );
+                        // the parent's write time moves along with its listing, a drive root keeps its separator
+                        std::size_t const separator = key.rfind( L'\\' );
+                        key.erase( key[ separator - 1 ] == L':' ? separator + 1 : separator );
+                        cache_.invalidate_key( key, false );
+                        if ( info.NextEntryOffset == 0 ) break;
+                        cursor += info.NextEntryOffset;
+                    }
+                }
+
+                status_cache & cache_;
+                std::wstring const root_;
+                smart_handle directory_handle_;
+                HANDLE stop_event_;
+                HANDLE io_event_;
+                std::thread thread_{};
+            };
+        }
+
+        status_cache::status_cache( status_cache_options const & options ) : options_( options ),
+            shards_{ nullptr }
+        {
+            if ( options_.shards == 0 ) options_.shards = 1;
+            shards_.reset( new shard[ options_.shards ] );
+        }
+
+        // watchers are stopped first, they hold a reference to the shards
+        status_cache::~status_cache()
+        {
+            std::lock_guard<std::mutex> lock{ watchers_mutex_ };
+            watchers_.clear();
+        }
+
+        status_cache::shard & status_cache::shard_of( std::wstring const & key ) noexcept
+        {
+            return shards_[ std::hash<std::wstring>{}( key ) % options_.shards ];
+        }
+
+        status_cache::entry status_cache::lookup( path const & p )
+        {
+            TINYDIR_TRACE_API( status_cache );
+            std::wstring key = details::cache_key( p );
+            shard & s = shard_of( key );
+            auto const now = clock::now();
+            std::uint64_t generation = 0;
+            {
+                std::shared_lock<std::shared_timed_mutex> lock{ s.mutex };
+                auto const iter = s.entries.find( key );
+                if ( iter != s.entries.end() && iter->second.expires > now ) return iter->second;
+                generation = s.generation;
+            }
+
+            // one call brings everything the cache answers for, the lock is not held while it runs
+            entry fresh{};
+            WIN32_FILE_ATTRIBUTE_DATA data{};
+            if ( TINYDIR_SYSCALL( get_file_attributes, GetFileAttributesExW( p.c_str(), GetFileExInfoStandard,
+                &data ) ) == 0 ) {
+                fresh.error = GetLastError();
+                fresh.status = file_status{ file_type::not_found };
+                if ( !options_.cache_missing ) return fresh;
+            } else if ( data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT ) {
+                // the reparse tag is not part of the attribute data, status() knows how to get it
+                std::error_code ec{};
+                fresh.status = fs::status( p, ec );
+            } else {
+                fresh.status = details::status_from_attributes( data.dwFileAttributes, 0 );
+            }
+            if ( fresh.error == 0 ) {
+                fresh.file_size = ( static_cast< std::uint64_t >( data.nFileSizeHigh ) << 32 ) | data.nFileSizeLow;
+                fresh.write_time = ( static_cast< std::uint64_t >( data.ftLastWriteTime.dwHighDateTime ) << 32 )
+                    | data.ftLastWriteTime.dwLowDateTime;
+            }
+            fresh.expires = now + options_.ttl;
+            if ( watcher_failed_ ) return fresh;
+
+            // an invalidation that came in while the lock was not held may be about p, what was found could
+            // already be stale then
+            std::unique_lock<std::shared_timed_mutex> lock{ s.mutex };
+            if ( s.generation == generation ) s.entries[ std::move( key ) ] = fresh;
+            return fresh;
+        }
+
+        file_status status_cache::status( path const & p )
+        {
+            return lookup( p ).status;
+        }
+
+        file_status status_cache::status( path const & p, std::error_code & ec ) noexcept
+        {
+            entry const e = lookup( p );
+            if ( e.error != 0 ) {
+                ec = std::error_code( fs::filesystem_error_codes::handle_not_opened );
+            } else {
+                ec.clear();
+            }
+            return e.status;
+        }
+
+        bool status_cache::exists( path const & p )
+        {
+            return fs::exists( status( p ) );
+        }
+
+        bool status_cache::exists( path const & p, std::error_code & ec ) noexcept
+        {
+            file_status const st = status( p, ec );
+            if ( st.type() == file_type::not_found ) ec.clear();
+            return fs::exists( st );
+        }
+
+        bool status_cache::is_directory( path const & p )
+        {
+            return fs::is_directory( status( p ) );
+        }
+
+        bool status_cache::is_directory( path const & p, std::error_code & ec ) noexcept
+        {
+            return fs::is_directory( status( p, ec ) );
+        }
+
+        bool status_cache::is_regular_file( path const & p )
+        {
+            return fs::is_regular_file( status( p ) );
+        }
+
+        bool status_cache::is_regular_file( path const & p, std::error_code & ec ) noexcept
+        {
+            return fs::is_regular_file( status( p, ec ) );
+        }
+
+        std::uintmax_t status_cache::file_size( path const & p )
+        {
+            entry const e = lookup( p );
+            if ( e.error != 0 || !fs::is_regular_file( e.status ) ) return static_cast< std::uintmax_t >( -1 );
+            return e.file_size;
+        }
+
+        std::uintmax_t status_cache::file_size( path const & p, std::error_code & ec ) noexcept
+        {
+            std::uintmax_t sizeof_file = static_cast< std::uintmax_t >( -1 );
+            FSERROR_TRY_CATCH( sizeof_file = file_size( p ), ec );
+            return sizeof_file;
+        }
+
+        file_time_type status_cache::last_write_time( path const & p )
+        {
+            entry const e = lookup( p );
+            if ( e.error != 0 ) {
+                throw fs::filesystem_error{ fs::details::get_windows_error( e.error ), p,
+                    std::error_code( fs::filesystem_error_codes::could_not_obtain_time ) };
+            }
+            ULARGE_INTEGER ticks{};
+            ticks.QuadPart = e.write_time;
+            return details::Win32FiletimeToChronoTime( FILETIME{ ticks.LowPart, ticks.HighPart } );
+        }
+
+        file_time_type status_cache::last_write_time( path const & p, std::error_code & ec ) noexcept
+        {
+            FSERROR_TRY_CATCH( return last_write_time( p ), ec );
+            return file_time_type{};
+        }
+
+        void status_cache::invalidate( path const & p )
+        {
+            invalidate_key( details::cache_key( p ), true );
+        }
+
+        void status_cache::invalidate_key( std::wstring const & key, bool whole_subtree )
+        {
+            {
+                shard & s = shard_of( key );
+                std::unique_lock<std::shared_timed_mutex> lock{ s.mutex };
+                ++s.generation;
+                auto const iter = s.entries.find( key );
+                if ( iter != s.entries.end() ) {
+                    whole_subtree = whole_subtree || fs::is_directory( iter->second.status );
+                    s.entries.erase( iter );
+                }
+                if ( !whole_subtree ) return;
+            }
+            // a directory that moved or went away takes its whole subtree with it, wherever that is cached
+            std::wstring const prefix = key.back() == L'\\' ? key : key + L'\\';
+            for ( std::size_t i = 0; i != options_.shards; ++i ) {
+                std::unique_lock<std::shared_timed_mutex> lock{ shards_[ i ].mutex };
+                ++shards_[ i ].generation;
+                auto & entries = shards_[ i ].entries;
+                for ( auto iter = entries.begin(); iter != entries.end(); ) {
+                    if ( iter->first.compare( 0, prefix.size(), prefix ) == 0 ) {
+                        iter = entries.erase( iter );
+                    } else {
+                        ++iter;
+                    }
+                }
+            }
+        }
+
+        void status_cache::clear() noexcept
+        {
+            for ( std::size_t i = 0; i != options_.shards; ++i ) {
+                std::unique_lock<std::shared_timed_mutex> lock{ shards_[ i ].mutex };
+                ++shards_[ i ].generation;
+                shards_[ i ].entries.clear();
+            }
+        }
+
+        std::size_t status_cache::size() const noexcept
+        {
+            std::size_t total = 0;
+            for ( std::size_t i = 0; i != options_.shards; ++i ) {
+                std::shared_lock<std::shared_timed_mutex> lock{ shards_[ i ].mutex };
+                total += shards_[ i ].entries.size();
+            }
+            return total;
+        }
+
+        void status_cache::watch( path const & directory )
+        {
+            std::unique_ptr<details::directory_watcher> watcher{ new details::directory_watcher{ *this, directory } };
+            std::lock_guard<std::mutex> lock{ watchers_mutex_ };
+            watchers_.push_back( std::move( watcher ) );
+        }
+
+        void status_cache::watch( path const & directory, std::error_code & ec ) noexcept
+        {
+            FSERROR_TRY_CATCH( watch( directory ), ec );
+        }
+    }
+}
+
+#undef FSERROR_TRY_CATCH
@@ -0,0 +1,123 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef TINYDIRCPP_STATUS_CACHE_HPP
+#define TINYDIRCPP_STATUS_CACHE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "tinydircpp.hpp"
+
+namespace tinydircpp {
+    namespace fs
+    {
+        struct status_cache_options {
+            // how long a looked up status is trusted before it is fetched again. With a watched directory the
+            // cache hears about changes as they happen and a much longer ttl is fine for paths under it.
+            std::chrono::milliseconds ttl{ 1000 };
+            // number of independently locked maps the entries are spread over
+            std::size_t shards = 16;
+            // cache failed lookups too, a path that does not exist costs a hash lookup like any other
+            bool cache_missing = true;
+        };
+
+        namespace details {
+            class directory_watcher;
+        }
+
+        // remembers status, size and write time of the paths asked about, so that asking again within ttl costs a
+        // hash lookup instead of a system call. Safe to use from any number of threads at once.
+        // Paths are cached by their spelling (case and separators aside): "a\\b" and "c:\\x\\a\\b" are two entries.
+        class status_cache {
+        public:
+            explicit status_cache( status_cache_options const & options = status_cache_options{} );
+            ~status_cache();
+            status_cache( status_cache const & ) = delete;
+            status_cache& operator=( status_cache const & ) = delete;
+
+            file_status status( path const & p );
+            file_status status( path const & p, std::error_code & ec ) noexcept;
+            bool exists( path const & p );
+            bool exists( path const & p, std::error_code & ec ) noexcept;
+            bool is_directory( path const & p );
+            bool is_directory( path const & p, std::error_code & ec ) noexcept;
+            bool is_regular_file( path const & p );
+            bool is_regular_file( path const & p, std::error_code & ec ) noexcept;
+            std::uintmax_t file_size( path const & p );
+            std::uintmax_t file_size( path const & p, std::error_code & ec ) noexcept;
+            file_time_type last_write_time( path const & p );
+            file_time_type last_write_time( path const & p, std::error_code & ec ) noexcept;
+
+            // drops p and everything cached below it. Whether p was a directory is not taken from the cache, which
+            // may never have seen it
+            void invalidate( path const & p );
+            void clear() noexcept;
+            std::size_t size() const noexcept;
+
+            // keeps the entries under directory (recursively) up to date with changes made to it, by whoever
+            // makes them, until the cache is destroyed. Changes that arrive faster than they can be read cost
+            // the whole cache rather than a stale answer. Should a watcher stop working altogether, the cache
+            // stops keeping anything: its long ttl can't be trusted any more.
+            void watch( path const & directory );
+            void watch( path const & directory, std::error_code & ec ) noexcept;
+        private:
+            friend class details::directory_watcher;
+            using clock = std::chrono::steady_clock;
+
+            struct entry {
+                clock::time_point expires{};
+                file_status status{};
+                std::uint64_t file_size = 0;
+                std::uint64_t write_time = 0; // raw FILETIME ticks
+                DWORD error = 0; // the lookup failed with this when not zero
+            };
+            struct shard {
+                mutable std::shared_timed_mutex mutex{};
+                std::unordered_map<std::wstring, entry> entries{};
+                // moves on with every invalidation, a lookup that started before one doesn't store what it found
+                std::uint64_t generation = 0;
+            };
+
+            entry lookup( path const & p );
+            void invalidate_key( std::wstring const & key, bool whole_subtree );
+            shard & shard_of( std::wstring const & key ) noexcept;
+
+            status_cache_options options_;
+            std::unique_ptr<shard[]> shards_;
+            std::atomic<bool> watcher_failed_{ false };
+            std::mutex watchers_mutex_{};
+            std::vector<std::unique_ptr<details::directory_watcher>> watchers_{};
+        };
+    }
+}
+#endif
@@ -0,0 +1,247 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "sync_tree.hpp"
+#include "scandir.hpp"
+#include "instrumentation.hpp"
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace tinydircpp {
+    namespace fs {
+        namespace details
+        {
+            // a directory's entries in the order both sides of a sync are walked in
+            struct sorted_listing {
+                scandir_result entries{};
+                std::vector<std::pair<std::wstring, std::size_t>> order{}; // lower-cased name, index in entries
+            };
+
+            sorted_listing list_sorted( path const & directory )
+            {
+                sorted_listing listing{};
+                listing.entries = scandir( directory, scandir_filter{}, scandir_sort::none );
+                listing.order.reserve( listing.entries.size() );
+                for ( std::size_t i = 0; i != listing.entries.size(); ++i ) {
+                    auto const & entry = listing.entries[ i ];
+                    listing.order.emplace_back( lower_case( std::wstring( entry.name(), entry.name_size() ) ), i );
+                }
+                std::sort( listing.order.begin(), listing.order.end() );
+                return listing;
+            }
+
+            path child_path( path const & directory, scandir_entry const & entry )
+            {
+                return child_path( directory, entry.name(), entry.name_size() );
+            }
+
+            bool same_contents( path const & a, path const & b )
+            {
+                smart_handle a_handle{ TINYDIR_SYSCALL( create_file, CreateFileW( a.c_str(), GENERIC_READ,
+                    FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr ) ) };
+                smart_handle b_handle{ TINYDIR_SYSCALL( create_file, CreateFileW( b.c_str(), GENERIC_READ,
+                    FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr ) ) };
+                if ( !a_handle || !b_handle ) {
+                    FSTHROW_MANUAL_DPATH( fs::filesystem_error_codes::handle_not_opened, a, b );
+                }
+                // both files are local, comparing the bytes stops at the first difference where hashing could not
+                std::vector<char> a_buffer( 256 * 1024 ), b_buffer( 256 * 1024 );
+                for ( ;; ) {
+                    DWORD a_read = 0, b_read = 0;
+                    if ( TINYDIR_SYSCALL( read_file, ReadFile( a_handle, a_buffer.data(),
+                        static_cast< DWORD >( a_buffer.size() ), &a_read, nullptr ) ) == 0
+                        || TINYDIR_SYSCALL( read_file, ReadFile( b_handle, b_buffer.data(),
+                            static_cast< DWORD >( b_buffer.size() ), &b_read, nullptr ) ) == 0 ) {
+                        FSTHROW_MANUAL_DPATH( fs::filesystem_error_codes::unknown_io_error, a, b );
+                    }
+                    if ( a_read != b_read || std::memcmp( a_buffer.data(), b_buffer.data(), a_read ) != 0 ) {
+                        return false;
+                    }
+                    if ( a_read == 0 ) return true;
+                }
+            }
+
+            class tree_syncer {
+            public:
+                explicit tree_syncer( sync_options const & options ) : options_( options ) {}
+
+                void sync_directory( path const & source, path const & destination, bool destination_exists )
+                {
+                    sorted_listing const from = list_sorted( source );
+                    sorted_listing const to = destination_exists ? list_sorted( destination ) : sorted_listing{};
+                    std::size_t i = 0, j = 0;
+                    while ( i != from.order.size() || j != to.order.size() ) {
+                        int const order = i == from.order.size() ? 1 : j == to.order.size() ? -1
+                            : from.order[ i ].first.compare( to.order[ j ].first );
+                        // every child is spelt from its parent's path, the entries' own path() is never used
+                        if ( order < 0 ) {
+                            auto const & entry = from.entries[ from.order[ i++ ].second ];
+                            add( entry, child_path( source, entry ), child_path( destination, entry ) );
+                        } else if ( order > 0 ) {
+                            auto const & entry = to.entries[ to.order[ j++ ].second ];
+                            if ( options_.delete_extraneous ) remove( child_path( destination, entry ), entry.type() );
+                        } else {
+                            auto const & from_entry = from.entries[ from.order[ i++ ].second ];
+                            auto const & to_entry = to.entries[ to.order[ j++ ].second ];
+                            update( from_entry, child_path( source, from_entry ), to_entry,
+                                child_path( destination, to_entry ) );
+                        }
+                    }
+                }
+
+                void create_directory( path const & p )
+                {
+                    if ( !options_.dry_run && TINYDIR_SYSCALL( create_directory,
+                        CreateDirectoryW( p.c_str(), nullptr ) ) == 0 ) {
+                        FSTHROW_MANUAL( fs::filesystem_error_codes::unknown_io_error, p );
+                    }
+                    ++result.directories_created;
+                }
+
+                sync_result result{};
+            private:
+                void add( scandir_entry const & source, path const & source_path, path const & destination )
+                {
+                    if ( source.is_symlink() ) {
+                        ++result.symlinks_skipped;
+                    } else if ( source.is_dir() ) {
+                        create_directory( destination );
+                        sync_directory( source_path, destination, false );
+                    } else {
+                        copy( source, source_path, destination );
+                    }
+                }
+
+                void update( scandir_entry const & source, path const & source_path,
+                    scandir_entry const & destination, path const & destination_path )
+                {
+                    if ( source.is_symlink() ) {
+                        ++result.symlinks_skipped;
+                        return;
+                    }
+                    if ( source.type() != destination.type() ) {
+                        remove( destination_path, destination.type() );
+                        add( source, source_path, destination_path );
+                    } else if ( source.is_dir() ) {
+                        sync_directory( source_path, destination_path, true );
+                    } else if ( changed( source, source_path, destination, destination_path ) ) {
+                        copy( source, source_path, destination_path );
+                    } else {
+                        ++result.files_unchanged;
+                    }
+                }
+
+                bool changed( scandir_entry const & source, path const & source_path,
+                    scandir_entry const & destination, path const & destination_path ) const
+                {
+                    if ( source.file_size() != destination.file_size() ) return true;
+                    auto const source_time = source.last_write_time(), destination_time = destination.last_write_time();
+                    auto const difference = source_time > destination_time ? source_time - destination_time
+                        : destination_time - source_time;
+                    if ( difference > options_.modify_window ) return true;
+                    return options_.compare_contents && !same_contents( source_path, destination_path );
+                }
+
+                void copy( scandir_entry const & source, path const & from, path const & destination )
+                {
+                    if ( !options_.dry_run ) {
+                        // CopyFileEx keeps the write time; past a few dozen megabytes skipping the cache is faster
+                        DWORD const flags = source.file_size() >= 64 * 1024 * 1024 ? COPY_FILE_NO_BUFFERING : 0;
+                        auto const copy_file = [&] {
+                            return TINYDIR_SYSCALL( copy_file, CopyFileExW( from.c_str(), destination.c_str(), nullptr,
+                                nullptr, nullptr, flags ) ) != 0;
+                        };
+                        if ( !copy_file() ) {
+                            // a read-only destination refuses to be overwritten
+                            if ( GetLastError() != ERROR_ACCESS_DENIED
+                                || SetFileAttributesW( destination.c_str(), FILE_ATTRIBUTE_NORMAL ) == 0
+                                || !copy_file() ) {
+                                FSTHROW_MANUAL_DPATH( fs::filesystem_error_codes::unknown_io_error, from, destination );
+                            }
+                        }
+                    }
+                    ++result.files_copied;
+                    result.bytes_copied += source.file_size();
+                    TINYDIR_COUNT_BYTES( sync_tree, source.file_size() );
+                }
+
+                void remove( path const & p, file_type type )
+                {
+                    if ( type == file_type::directory ) {
+                        auto const listing = scandir( p, scandir_filter{}, scandir_sort::none );
+                        for ( auto const & entry : listing ) remove( child_path( p, entry ), entry.type() );
+                    }
+                    if ( !options_.dry_run ) {
+                        // a symlink to a directory is removed like a directory, without touching what it points to
+                        bool const removed = type == file_type::directory
+                            ? TINYDIR_SYSCALL( remove, RemoveDirectoryW( p.c_str() ) ) != 0
+                            : TINYDIR_SYSCALL( remove, DeleteFileW( p.c_str() ) ) != 0
+                            || ( SetFileAttributesW( p.c_str(), FILE_ATTRIBUTE_NORMAL ) != 0
+                                && TINYDIR_SYSCALL( remove, DeleteFileW( p.c_str() ) ) != 0 )
+                            || ( type == file_type::symlink
+                                && TINYDIR_SYSCALL( remove, RemoveDirectoryW( p.c_str() ) ) != 0 );
+                        if ( !removed ) {
+                            FSTHROW_MANUAL( fs::filesystem_error_codes::unknown_io_error, p );
+                        }
+                    }
+                    ++( type == file_type::directory ? result.directories_deleted : result.files_deleted );
+                }
+
+                sync_options const options_;
+            };
+        }
+
+        sync_result sync_tree( path const & source, path const & destination, sync_options const & options )
+        {
+            TINYDIR_TRACE_API( sync_tree );
+            if ( !is_directory( source ) ) {
+                FSTHROW( std::errc::not_a_directory, source );
+            }
+            bool const destination_exists = exists( destination );
+            if ( destination_exists && !is_directory( destination ) ) {
+                FSTHROW( std::errc::not_a_directory, destination );
+            }
+            std::error_code ec{};
+            if ( destination_exists && equivalent( source, destination, ec ) ) return sync_result{};
+
+            details::tree_syncer syncer{ options };
+            if ( !destination_exists ) syncer.create_directory( destination );
+            syncer.sync_directory( source, destination, destination_exists );
+            return syncer.result;
+        }
+
+        sync_result sync_tree( path const & source, path const & destination, sync_options const & options,
+            std::error_code & ec ) noexcept
+        {
+            FSERROR_TRY_CATCH( return sync_tree( source, destination, options ), ec );
+            return sync_result{};
+        }
+    }
+}
+
+#undef FSERROR_TRY_CATCH
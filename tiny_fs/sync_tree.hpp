@@ -0,0 +1,68 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef TINYDIRCPP_SYNC_TREE_HPP
+#define TINYDIRCPP_SYNC_TREE_HPP
+
+#include <chrono>
+#include <cstdint>
+
+#include "tinydircpp.hpp"
+
+namespace tinydircpp {
+    namespace fs
+    {
+        struct sync_options {
+            // remove what is in the destination but not in the source
+            bool delete_extraneous = false;
+            // files of equal size and write time are compared byte by byte too, instead of trusted to be the same
+            bool compare_contents = false;
+            // work out and count what would be done, without doing it
+            bool dry_run = false;
+            // write times closer than this count as equal; 2s suits FAT volumes
+            std::chrono::milliseconds modify_window{ 0 };
+        };
+
+        struct sync_result {
+            std::uintmax_t files_copied = 0;
+            std::uintmax_t bytes_copied = 0;
+            std::uintmax_t files_unchanged = 0;
+            std::uintmax_t files_deleted = 0;
+            std::uintmax_t directories_created = 0;
+            std::uintmax_t directories_deleted = 0;
+            std::uintmax_t symlinks_skipped = 0;
+        };
+
+        // makes destination a mirror of source. Both directories are listed once per level, sorted and walked side by
+        // side, matching names case-insensitively; a file is copied when its size or write time differ (or its
+        // contents, with compare_contents). Copies keep the source's write time, so an unchanged file is recognized
+        // on the next run. Symlinks are neither followed nor copied.
+        sync_result sync_tree( path const & source, path const & destination,
+            sync_options const & options = sync_options{} );
+        sync_result sync_tree( path const & source, path const & destination, sync_options const & options,
+            std::error_code & ec ) noexcept;
+    }
+}
+#endif
@@ -0,0 +1,206 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "tempfile.hpp"
+#include "instrumentation.hpp"
+#include <algorithm>
+#include <vector>
+
+namespace tinydircpp {
+    namespace fs {
+        namespace details
+        {
+            // with 64 random bits a name is taken twice about never, the retries are for the odd leftover
+            constexpr int max_name_attempts = 16;
+
+            bool set_delete_on_close( HANDLE file, bool delete_on_close ) noexcept
+            {
+                FILE_DISPOSITION_INFO disposition{};
+                disposition.DeleteFile = delete_on_close;
+                return TINYDIR_SYSCALL( set_file_information, SetFileInformationByHandle( file, FileDispositionInfo,
+                    &disposition, sizeof( disposition ) ) ) != 0;
+            }
+        }
+
+        temporary_file::temporary_file() : temporary_file{ temporary_directory_path() }
+        {
+        }
+
+        temporary_file::temporary_file( file_path const & directory )
+        {
+            TINYDIR_TRACE_API( temporary_files );
+            for ( int attempt = 0; attempt != details::max_name_attempts; ++attempt ) {
+                // operator/ would drop the leading dot after the separator temporary_directory_path() ends with
+                std::wstring const name = unique_path( file_path{ L".tmp-%%%%%%%%%%%%%%%%" } ).native();
+                file_path const candidate = details::child_path( directory, name.c_str(), name.size() );
+                // FILE_ATTRIBUTE_TEMPORARY asks the cache manager to keep the data in memory for as long as it can
+                DWORD const access = GENERIC_READ | GENERIC_WRITE | DELETE;
+                HANDLE const file = TINYDIR_SYSCALL( create_file, CreateFileW( candidate.c_str(), access, 0, nullptr,
+                    CREATE_NEW, FILE_ATTRIBUTE_TEMPORARY, nullptr ) );
+                if ( file == INVALID_HANDLE_VALUE ) {
+                    if ( GetLastError() == ERROR_FILE_EXISTS ) continue;
+                    FSTHROW_MANUAL( fs::filesystem_error_codes::handle_not_opened, candidate );
+                }
+                // marked for deletion right away, the system removes it when the handle goes for whatever reason
+                if ( !details::set_delete_on_close( file, true ) ) {
+                    DWORD const error = GetLastError();
+                    CloseHandle( file );
+                    TINYDIR_SYSCALL( remove, DeleteFileW( candidate.c_str() ) );
+                    SetLastError( error );
+                    FSTHROW_MANUAL( fs::filesystem_error_codes::unknown_io_error, candidate );
+                }
+                handle_ = file;
+                path_ = candidate;
+                return;
+            }
+            throw fs::filesystem_error{ "no unused temporary file name found", directory,
+                std::make_error_code( std::errc::file_exists ) };
+        }
+
+        temporary_file::temporary_file( temporary_file && other ) noexcept :
+            handle_{ other.handle_ }, path_{ std::move( other.path_ ) }, kept_{ other.kept_ }
+        {
+            other.handle_ = INVALID_HANDLE_VALUE;
+        }
+
+        temporary_file& temporary_file::operator=( temporary_file && other ) noexcept
+        {
+            if ( this != &other ) {
+                close();
+                handle_ = other.handle_;
+                path_ = std::move( other.path_ );
+                kept_ = other.kept_;
+                other.handle_ = INVALID_HANDLE_VALUE;
+            }
+            return *this;
+        }
+
+        temporary_file::~temporary_file()
+        {
+            close();
+        }
+
+        void temporary_file::close() noexcept
+        {
+            if ( handle_ != INVALID_HANDLE_VALUE ) CloseHandle( handle_ );
+            handle_ = INVALID_HANDLE_VALUE;
+        }
+
+        void temporary_file::write( void const * data, std::size_t size )
+        {
+            TINYDIR_TRACE_API( temporary_files );
+            TINYDIR_COUNT_BYTES( temporary_files, size );
+            char const * bytes = static_cast< char const * >( data );
+            std::size_t const max_chunk = 64 * 1024 * 1024;
+            while ( size != 0 ) {
+                DWORD const chunk = static_cast< DWORD >( ( std::min )( size, max_chunk ) );
+                DWORD done = 0;
+                if ( TINYDIR_SYSCALL( write_file, WriteFile( handle_, bytes, chunk, &done, nullptr ) ) == 0 ) {
+                    FSTHROW_MANUAL( fs::filesystem_error_codes::unknown_io_error, path_ );
+                }
+                bytes += done;
+                size -= done;
+            }
+        }
+
+        void temporary_file::keep_as( file_path const & target )
+        {
+            TINYDIR_TRACE_API( temporary_files );
+            // renamed through the handle, the file never shows up under a name nobody else can open
+            std::wstring const full_target = abspath( target ).native();
+            std::vector<char> buffer( sizeof( FILE_RENAME_INFO ) + full_target.size() * sizeof( wchar_t ) );
+            auto & rename_info = *reinterpret_cast< FILE_RENAME_INFO * >( buffer.data() );
+            rename_info.ReplaceIfExists = TRUE;
+            rename_info.RootDirectory = nullptr;
+            rename_info.FileNameLength = static_cast< DWORD >( full_target.size() * sizeof( wchar_t ) );
+            std::copy( full_target.begin(), full_target.end(), rename_info.FileName );
+
+            // a file waiting to be deleted can't be renamed, it is taken off the list first
+            if ( !details::set_delete_on_close( handle_, false ) ) {
+                FSTHROW_MANUAL( fs::filesystem_error_codes::unknown_io_error, path_ );
+            }
+            if ( TINYDIR_SYSCALL( move_file, SetFileInformationByHandle( handle_, FileRenameInfo, buffer.data(),
+                static_cast< DWORD >( buffer.size() ) ) ) == 0 ) {
+                DWORD const error = GetLastError();
+                details::set_delete_on_close( handle_, true );
+                SetLastError( error );
+                FSTHROW_MANUAL_DPATH( fs::filesystem_error_codes::unknown_io_error, path_, target );
+            }
+            path_ = file_path{ full_target };
+            kept_ = true;
+
+            // kept files are ordinary ones, the cache manager may write them out lazily from now on. Zeroed
+            // times are left as they are
+            FILE_BASIC_INFO basic_info{};
+            if ( TINYDIR_SYSCALL( get_file_information, GetFileInformationByHandleEx( handle_, FileBasicInfo,
+                &basic_info, sizeof( basic_info ) ) ) == 0 ) {
+                FSTHROW_MANUAL( fs::filesystem_error_codes::unknown_io_error, path_ );
+            }
+            DWORD const attributes = basic_info.FileAttributes & ~static_cast< DWORD >( FILE_ATTRIBUTE_TEMPORARY );
+            basic_info = FILE_BASIC_INFO{};
+            basic_info.FileAttributes = attributes == 0 ? FILE_ATTRIBUTE_NORMAL : attributes;
+            if ( TINYDIR_SYSCALL( set_file_information, SetFileInformationByHandle( handle_, FileBasicInfo,
+                &basic_info, sizeof( basic_info ) ) ) == 0 ) {
+                FSTHROW_MANUAL( fs::filesystem_error_codes::unknown_io_error, path_ );
+            }
+        }
+
+        void temporary_file::keep_as( file_path const & target, std::error_code & ec ) noexcept
+        {
+            FSERROR_TRY_CATCH( keep_as( target ), ec );
+        }
+
+        path create_temporary_directory( path const & parent, std::wstring const & prefix )
+        {
+            TINYDIR_TRACE_API( temporary_files );
+            for ( int attempt = 0; attempt != details::max_name_attempts; ++attempt ) {
+                std::wstring const name = unique_path( path{ prefix + L"%%%%%%%%%%%%%%%%" } ).native();
+                path const candidate = details::child_path( parent, name.c_str(), name.size() );
+                if ( TINYDIR_SYSCALL( create_directory, CreateDirectoryW( candidate.c_str(), nullptr ) ) != 0 ) {
+                    return candidate;
+                }
+                if ( GetLastError() != ERROR_ALREADY_EXISTS ) {
+                    FSTHROW_MANUAL( fs::filesystem_error_codes::unknown_io_error, candidate );
+                }
+            }
+            throw fs::filesystem_error{ "no unused temporary directory name found", parent,
+                std::make_error_code( std::errc::file_exists ) };
+        }
+
+        path create_temporary_directory( path const & parent, std::wstring const & prefix,
+            std::error_code & ec ) noexcept
+        {
+            FSERROR_TRY_CATCH( return create_temporary_directory( parent, prefix ), ec );
+            return path{};
+        }
+
+        path create_temporary_directory()
+        {
+            return create_temporary_directory( temporary_directory_path() );
+        }
+    }
+}
+
+#undef FSERROR_TRY_CATCH
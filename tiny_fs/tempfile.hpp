@@ -0,0 +1,78 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef TINYDIRCPP_TEMPFILE_HPP
+#define TINYDIRCPP_TEMPFILE_HPP
+
+#include <string>
+
+#include "tinydircpp.hpp"
+
+namespace tinydircpp {
+    namespace fs
+    {
+        // a scratch file that is gone once it is closed, even when the process dies holding it, unless it is kept
+        // under a name of its own first: the counterpart of an O_TMPFILE file that may be linked in later.
+        // Nobody else can open it meanwhile. Its name is random, so any number of threads can make them side by
+        // side without running into each other's names.
+        class temporary_file {
+            using file_path = path;
+        public:
+            temporary_file();
+            explicit temporary_file( file_path const & directory );
+            temporary_file( temporary_file && other ) noexcept;
+            temporary_file& operator=( temporary_file && other ) noexcept;
+            temporary_file( temporary_file const & ) = delete;
+            temporary_file& operator=( temporary_file const & ) = delete;
+            ~temporary_file();
+
+            HANDLE native_handle() const noexcept { return handle_; }
+            // where the file is now, its random name until it is kept
+            file_path const & path() const noexcept { return path_; }
+            bool kept() const noexcept { return kept_; }
+
+            void write( void const * data, std::size_t size );
+            void write( std::string const & data ) { write( data.data(), data.size() ); }
+
+            // renames the file to target, replacing whatever is there, and keeps it once it is closed. target has
+            // to be on the same volume.
+            void keep_as( file_path const & target );
+            void keep_as( file_path const & target, std::error_code & ec ) noexcept;
+        private:
+            void close() noexcept;
+
+            HANDLE handle_ = INVALID_HANDLE_VALUE;
+            file_path path_{};
+            bool kept_ = false;
+        };
+
+        // mkdtemp(): creates a new directory named prefix followed by random characters under parent
+        path create_temporary_directory( path const & parent, std::wstring const & prefix = L"tmp" );
+        path create_temporary_directory( path const & parent, std::wstring const & prefix,
+            std::error_code & ec ) noexcept;
+        path create_temporary_directory();
+    }
+}
+#endif
@@ -0,0 +1,177 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "timestamps.hpp"
+#include "instrumentation.hpp"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace tinydircpp {
+    namespace fs {
+        namespace details
+        {
+            // nanoseconds since 1970 run out in 1678 and 2262, FILETIME goes from 1601 to 30828. A zero FILETIME
+            // is how Windows says it doesn't know
+            precise_file_time to_precise_time( FILETIME const & filetime )
+            {
+                constexpr std::int64_t max_ticks = std::chrono::duration_cast< filetime_ticks >(
+                    std::chrono::nanoseconds::max() ).count();
+                ULARGE_INTEGER ticks{};
+                ticks.LowPart = filetime.dwLowDateTime;
+                ticks.HighPart = filetime.dwHighDateTime;
+                if ( ticks.QuadPart == 0 || ticks.QuadPart > static_cast< std::uint64_t >( max_ticks
+                    + unix_epoch_ticks ) ) {
+                    return omit_time;
+                }
+                filetime_ticks const since_epoch{ static_cast< std::int64_t >( ticks.QuadPart ) - unix_epoch_ticks };
+                if ( since_epoch.count() < -max_ticks ) return omit_time;
+                return precise_file_time{ std::chrono::duration_cast< std::chrono::nanoseconds >( since_epoch ) };
+            }
+
+            FILETIME to_filetime( precise_file_time const & time )
+            {
+                auto const since_epoch = std::chrono::duration_cast< filetime_ticks >( time.time_since_epoch() );
+                ULARGE_INTEGER ticks{};
+                ticks.QuadPart = static_cast< std::uint64_t >( since_epoch.count() + unix_epoch_ticks );
+                return FILETIME{ ticks.LowPart, ticks.HighPart };
+            }
+
+            DWORD open_flags( bool follow_symlinks ) noexcept
+            {
+                return follow_symlinks ? FILE_FLAG_BACKUP_SEMANTICS
+                    : FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OPEN_REPARSE_POINT;
+            }
+
+            void apply_file_times( path const & p, file_times const & times, bool follow_symlinks )
+            {
+                FILETIME creation{}, last_access{}, last_write{};
+                FILETIME const * const creation_ptr = times.creation == omit_time ? nullptr
+                    : &( creation = to_filetime( times.creation ) );
+                FILETIME const * const last_access_ptr = times.last_access == omit_time ? nullptr
+                    : &( last_access = to_filetime( times.last_access ) );
+                FILETIME const * const last_write_ptr = times.last_write == omit_time ? nullptr
+                    : &( last_write = to_filetime( times.last_write ) );
+                if ( !creation_ptr && !last_access_ptr && !last_write_ptr ) return;
+
+                // FILE_WRITE_ATTRIBUTES is all SetFileTime needs, and unlike GENERIC_WRITE it is granted on read-only
+                // files and doesn't conflict with other handles open on p
+                smart_handle file{ TINYDIR_SYSCALL( create_file, CreateFileW( p.c_str(), FILE_WRITE_ATTRIBUTES,
+                    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                    open_flags( follow_symlinks ), nullptr ) ) };
+                if ( !file ) {
+                    FSTHROW_MANUAL( fs::filesystem_error_codes::handle_not_opened, p );
+                }
+                if ( TINYDIR_SYSCALL( set_file_time, SetFileTime( file, creation_ptr, last_access_ptr,
+                    last_write_ptr ) ) == 0 ) {
+                    FSTHROW_MANUAL( fs::filesystem_error_codes::set_filetime_error, p );
+                }
+            }
+        }
+
+        file_times get_file_times( path const & p, bool follow_symlinks )
+        {
+            TINYDIR_TRACE_API( file_times );
+            WIN32_FILE_ATTRIBUTE_DATA file_data{};
+            if ( TINYDIR_SYSCALL( get_file_attributes, GetFileAttributesExW( p.c_str(), GetFileExInfoStandard,
+                &file_data ) ) == 0 ) {
+                FSTHROW_MANUAL( fs::filesystem_error_codes::could_not_obtain_time, p );
+            }
+            // GetFileAttributesExW answers for the link itself, only a followed link needs its target opened
+            if ( follow_symlinks && ( file_data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT ) ) {
+                details::smart_handle file{ TINYDIR_SYSCALL( create_file, CreateFileW( p.c_str(),
+                    FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                    OPEN_EXISTING, details::open_flags( true ), nullptr ) ) };
+                if ( !file ) {
+                    FSTHROW_MANUAL( fs::filesystem_error_codes::handle_not_opened, p );
+                }
+                if ( TINYDIR_SYSCALL( get_file_time, GetFileTime( file, &file_data.ftCreationTime,
+                    &file_data.ftLastAccessTime, &file_data.ftLastWriteTime ) ) == 0 ) {
+                    FSTHROW_MANUAL( fs::filesystem_error_codes::could_not_obtain_time, p );
+                }
+            }
+            file_times times{};
+            times.creation = details::to_precise_time( file_data.ftCreationTime );
+            times.last_access = details::to_precise_time( file_data.ftLastAccessTime );
+            times.last_write = details::to_precise_time( file_data.ftLastWriteTime );
+            return times;
+        }
+
+        file_times get_file_times( path const & p, std::error_code & ec ) noexcept
+        {
+            return get_file_times( p, true, ec );
+        }
+
+        file_times get_file_times( path const & p, bool follow_symlinks, std::error_code & ec ) noexcept
+        {
+            FSERROR_TRY_CATCH( return get_file_times( p, follow_symlinks ), ec );
+            return file_times{};
+        }
+
+        void set_file_times( path const & p, file_times const & times, bool follow_symlinks )
+        {
+            TINYDIR_TRACE_API( file_times );
+            details::apply_file_times( p, times, follow_symlinks );
+        }
+
+        void set_file_times( path const & p, file_times const & times, std::error_code & ec ) noexcept
+        {
+            set_file_times( p, times, true, ec );
+        }
+
+        void set_file_times( path const & p, file_times const & times, bool follow_symlinks,
+            std::error_code & ec ) noexcept
+        {
+            FSERROR_TRY_CATCH( set_file_times( p, times, follow_symlinks ), ec );
+        }
+
+        std::size_t set_file_times( std::vector<file_times_update> const & updates, std::size_t thread_count )
+        {
+            TINYDIR_TRACE_API( file_times );
+            if ( thread_count == 0 ) thread_count = ( std::max )( 1u, std::thread::hardware_concurrency() );
+            thread_count = ( std::min )( thread_count, updates.size() );
+
+            std::atomic<std::size_t> next_update{ 0 };
+            std::atomic<std::size_t> failures{ 0 };
+            auto const worker = [&] {
+                for ( std::size_t i = next_update++; i < updates.size(); i = next_update++ ) {
+                    try {
+                        details::apply_file_times( updates[ i ].target, updates[ i ].times,
+                            updates[ i ].follow_symlinks );
+                    } catch ( fs::filesystem_error const & ) {
+                        ++failures;
+                    }
+                }
+            };
+            std::vector<std::thread> threads{};
+            for ( std::size_t i = 1; i < thread_count; ++i ) threads.emplace_back( worker );
+            worker();
+            for ( auto & t : threads ) t.join();
+            return failures;
+        }
+    }
+}
+
+#undef FSERROR_TRY_CATCH
@@ -0,0 +1,81 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef TINYDIRCPP_TIMESTAMPS_HPP
+#define TINYDIRCPP_TIMESTAMPS_HPP
+
+#include <chrono>
+#include <utility>
+#include <vector>
+
+#include "tinydircpp.hpp"
+
+namespace tinydircpp {
+    namespace fs
+    {
+        // file times to the nanosecond. NTFS keeps them in 100ns ticks, so that is as fine as they get on disk, but
+        // nothing on the way there rounds them to whole seconds the way time_t does.
+        using precise_file_time = std::chrono::time_point<std::chrono::system_clock, std::chrono::nanoseconds>;
+
+        // leaves a time as it is when passed to set_file_times, like UTIME_OMIT does for utimensat
+        constexpr precise_file_time omit_time = precise_file_time::min();
+
+        struct file_times {
+            precise_file_time creation = omit_time;
+            precise_file_time last_access = omit_time;
+            precise_file_time last_write = omit_time;
+        };
+
+        // all three times from a single query. Like stat(), a symlink's target is asked unless follow_symlinks is
+        // false, which asks about the link itself the way lstat() does. A time the system can't tell, or one this
+        // clock can't hold (before 1678 or after 2262), comes back as omit_time.
+        file_times get_file_times( path const & p, bool follow_symlinks = true );
+        file_times get_file_times( path const & p, std::error_code & ec ) noexcept;
+        file_times get_file_times( path const & p, bool follow_symlinks, std::error_code & ec ) noexcept;
+
+        // sets every time that isn't omit_time with one open and one SetFileTime call, p may be a directory. Links
+        // are followed the same way get_file_times follows them
+        void set_file_times( path const & p, file_times const & times, bool follow_symlinks = true );
+        void set_file_times( path const & p, file_times const & times, std::error_code & ec ) noexcept;
+        void set_file_times( path const & p, file_times const & times, bool follow_symlinks,
+            std::error_code & ec ) noexcept;
+
+        struct file_times_update {
+            file_times_update( path t, file_times const & ts, bool follow = true ) :
+                target( std::move( t ) ), times( ts ), follow_symlinks( follow )
+            {
+            }
+
+            path target;
+            file_times times;
+            bool follow_symlinks;
+        };
+
+        // applies the updates side by side on thread_count threads (0 picks one per core) and returns how many of
+        // them failed; a failed update doesn't stop the others
+        std::size_t set_file_times( std::vector<file_times_update> const & updates, std::size_t thread_count = 0 );
+    }
+}
+#endif
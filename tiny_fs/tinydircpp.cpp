@@ -27,22 +27,27 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 
 #include "tinydircpp.hpp"
+#include "instrumentation.hpp"
 #include <system_error>
 #include <tuple>
+#include <atomic>
+#include <deque>
+#include <future>
+#include <mutex>
 
 #ifdef _WIN32
 #include <winbase.h>
 #include <ShlObj.h>
 #endif // _WIN32
 
+// Windows 10 1803 SDK and later, older ones don't know about AF_UNIX sockets
+#ifndef IO_REPARSE_TAG_AF_UNIX
+#define IO_REPARSE_TAG_AF_UNIX 0x80000023L
+#endif
+
 namespace tinydircpp {
     namespace fs {
 
-        file_status::file_status( file_type ft, perms permission ) noexcept:
-        ft_{ ft }, permission_{ permission }
-        {
-        }
-
         void file_status::type( file_type ft ) noexcept
         {
             ft_ = ft;
@@ -58,15 +63,211 @@ namespace tinydircpp {
             return stat1.ft_ == stat2.ft_ && stat2.permission_ == stat1.permission_;
         }
 
+        namespace details
+        {
+            file_status status_from_attributes( DWORD file_attrib, DWORD reparse_tag ) noexcept
+            {
+                // by [reparse point][symlink tag, AF_UNIX tag or neither][directory]. Other reparse points, junctions
+                // and the placeholders of deduplicated or cloud files among them, stay unknown
+                static constexpr file_type types[ 2 ][ 3 ][ 2 ] = {
+                    {
+                        { file_type::regular, file_type::directory },
+                        { file_type::regular, file_type::directory },
+                        { file_type::regular, file_type::directory }
+                    },
+                    {
+                        { file_type::unknown, file_type::unknown },
+                        { file_type::symlink, file_type::symlink },
+                        { file_type::socket, file_type::socket }
+                    }
+                };
+                // the read-only attribute is all there is to go on, it takes the write bits away
+                static constexpr perms permissions[ 2 ] = { perms::all, static_cast< perms >( 0555 ) };
+
+                std::size_t const reparse_point = ( file_attrib & FILE_ATTRIBUTE_REPARSE_POINT ) != 0;
+                std::size_t const tag = ( reparse_tag == IO_REPARSE_TAG_SYMLINK )
+                    + 2 * ( reparse_tag == IO_REPARSE_TAG_AF_UNIX );
+                std::size_t const directory = ( file_attrib & FILE_ATTRIBUTE_DIRECTORY ) != 0;
+                std::size_t const read_only = ( file_attrib & FILE_ATTRIBUTE_READONLY ) != 0;
+                return file_status{ types[ reparse_point ][ tag ][ directory ], permissions[ read_only ] };
+            }
+
+            // whether to follow symlinks is up to the caller, which passes the attributes of the right file
+            DWORD attributes_with_perms( DWORD file_attrib, perms prms, permissions_status how ) noexcept
+            {
+                int const write_bits = static_cast< int >( perms::owner_write )
+                    | static_cast< int >( perms::group_write ) | static_cast< int >( perms::others_write );
+                int const current = static_cast< int >( status_from_attributes( file_attrib, 0 ).permission() );
+                int wanted = static_cast< int >( prms );
+                switch ( static_cast< int >( how ) & ~static_cast< int >( permissions_status::follow_symlinks ) ) {
+                case static_cast< int >( permissions_status::add_bits ):
+                    wanted |= current;
+                    break;
+                case static_cast< int >( permissions_status::remove_bits ):
+                    wanted = current & ~wanted;
+                    break;
+                }
+                return ( wanted & write_bits ) != 0 ? file_attrib & ~FILE_ATTRIBUTE_READONLY
+                    : file_attrib | FILE_ATTRIBUTE_READONLY;
+            }
+
+            bool is_dot_or_dotdot( wchar_t const * filename ) noexcept
+            {
+                return std::wcscmp( filename, L"." ) == 0 || std::wcscmp( filename, L".." ) == 0;
+            }
+
+            // everything FindFirstFile/FindNextFile tells us about an entry is kept, so that the common
+            // status()/file_size()/last_write_time() calls on a directory_entry don't go back to the disk
+            directory_entry make_directory_entry( path const & parent, WIN32_FIND_DATAW const & find_data )
+            {
+                directory_entry entry{ parent / path{ find_data.cFileName } };
+                entry.status_ = status_from_attributes( find_data.dwFileAttributes, find_data.dwReserved0 );
+                if ( is_symlink( entry.status_ ) ) {
+                    entry.symlink_status_ = entry.status_;
+                } else if ( is_regular_file( entry.status_ ) ) {
+                    ULARGE_INTEGER size{};
+                    size.LowPart = find_data.nFileSizeLow;
+                    size.HighPart = find_data.nFileSizeHigh;
+                    entry.file_size_ = size.QuadPart;
+                }
+                entry.last_write_time_ = Win32FiletimeToChronoTime( find_data.ftLastWriteTime );
+                return entry;
+            }
+
+            class directory_prefetcher {
+            public:
+                directory_prefetcher( HANDLE search_handle, path const & directory, std::size_t batch_size ) :
+                    search_handle_{ search_handle }, directory_{ directory }, batch_size_{ batch_size }
+                {
+                    schedule();
+                }
+                directory_prefetcher( directory_prefetcher const & ) = delete;
+                directory_prefetcher& operator=( directory_prefetcher const & ) = delete;
+
+                ~directory_prefetcher()
+                {
+                    if ( pending_.valid() ) pending_.wait();
+                    FindClose( search_handle_ );
+                }
+
+                bool next( directory_entry & entry )
+                {
+                    // a batch may come back empty (nothing but "." and "..") without the directory being done
+                    while ( ready_.empty() ) {
+                        if ( pending_.valid() ) {
+                            std::vector<directory_entry> batch = pending_.get();
+                            std::move( batch.begin(), batch.end(), std::back_inserter( ready_ ) );
+                            schedule(); // the next batch is read while the caller works through this one
+                        } else if ( !exhausted_ ) {
+                            schedule(); // the last batch was read in place for want of a thread, try again
+                        } else {
+                            return false;
+                        }
+                    }
+                    entry = std::move( ready_.front() );
+                    ready_.pop_front();
+                    return true;
+                }
+            private:
+                std::vector<directory_entry> read_batch()
+                {
+                    std::vector<directory_entry> batch{};
+                    batch.reserve( batch_size_ );
+                    WIN32_FIND_DATAW find_data{};
+                    while ( batch.size() < batch_size_ ) {
+                        if ( TINYDIR_SYSCALL( find_next_file, FindNextFileW( search_handle_, &find_data ) ) == 0 ) {
+                            exhausted_ = true;
+                            break;
+                        }
+                        if ( !is_dot_or_dotdot( find_data.cFileName ) ) {
+                            batch.push_back( make_directory_entry( directory_, find_data ) );
+                        }
+                    }
+                    return batch;
+                }
+
+                void schedule()
+                {
+                    if ( exhausted_ ) return;
+                    try {
+                        pending_ = std::async( std::launch::async, [this] { return read_batch(); } );
+                    } catch ( std::system_error const & ) { // no thread available, read this batch on the caller's
+                        std::vector<directory_entry> batch = read_batch();
+                        std::move( batch.begin(), batch.end(), std::back_inserter( ready_ ) );
+                    }
+                }
+
+                HANDLE const search_handle_;
+                path const directory_;
+                std::size_t const batch_size_;
+                std::deque<directory_entry> ready_{};
+                std::future<std::vector<directory_entry>> pending_{};
+                bool exhausted_ = false;
+            };
+
+            // the enumeration all copies of a directory_iterator share
+            struct directory_iteration_state {
+                explicit directory_iteration_state( path const & p ) : directory{ p }
+                {
+                }
+                directory_iteration_state( directory_iteration_state const & ) = delete;
+                directory_iteration_state& operator=( directory_iteration_state const & ) = delete;
+
+                ~directory_iteration_state()
+                {
+                    if ( !prefetcher && search_handle != INVALID_HANDLE_VALUE ) FindClose( search_handle );
+                }
+
+                // moves entry on to the next one, or sets done. The caller holds mutex.
+                void advance()
+                {
+                    if ( prefetcher ) {
+                        if ( prefetcher->next( entry ) ) return;
+                        prefetcher.reset(); // closes search_handle
+                    } else {
+                        WIN32_FIND_DATAW find_data{};
+                        bool found = TINYDIR_SYSCALL( find_next_file, FindNextFileW( search_handle, &find_data ) ) != 0;
+                        while ( found && is_dot_or_dotdot( find_data.cFileName ) ) {
+                            found = TINYDIR_SYSCALL( find_next_file, FindNextFileW( search_handle, &find_data ) ) != 0;
+                        }
+                        if ( found ) {
+                            entry = make_directory_entry( directory, find_data );
+                            return;
+                        }
+                        FindClose( search_handle );
+                    }
+                    search_handle = INVALID_HANDLE_VALUE;
+                    entry.assign( path{} );
+                    done = true;
+                }
+
+                std::mutex mutex{};
+                path const directory;
+                HANDLE search_handle = INVALID_HANDLE_VALUE;
+                // non-null only when the iterator was asked to read ahead, owns search_handle in that case
+                std::unique_ptr<directory_prefetcher> prefetcher{};
+                directory_entry entry{};
+                std::atomic<bool> done{ false };
+            };
+        }
+
         path current_path()
         {
-            wchar_t file_path[ TINYDIR_FILENAME_MAX + 2 ] = {};
-            DWORD const len_current_directory{ GetCurrentDirectoryW( TINYDIR_FILENAME_MAX, file_path ) };
-            if ( len_current_directory == 0 )
-                throw fs::filesystem_error( "Unable to get directory name", fs::filesystem_error_codes::directory_name_unobtainable );
-            else if ( len_current_directory > ( TINYDIR_FILENAME_MAX + 2 ) )
-                throw fs::filesystem_error( "filename too long", std::make_error_code( std::errc::filename_too_long ) );
-            return path{ file_path };
+            // sized by asking first, like abspath(); asked again should another thread change it in between
+            std::wstring directory( TINYDIR_PATH_MAX, L'\0' );
+            for ( ;; ) {
+                DWORD const size = TINYDIR_SYSCALL( current_directory,
+                    GetCurrentDirectoryW( static_cast< DWORD >( directory.size() ), &directory[ 0 ] ) );
+                if ( size == 0 ) {
+                    throw fs::filesystem_error( "Unable to get directory name",
+                        fs::filesystem_error_codes::directory_name_unobtainable );
+                }
+                if ( size < directory.size() ) {
+                    directory.resize( size );
+                    return path{ directory };
+                }
+                directory.resize( size );
+            }
         }
 
         path current_path( std::error_code & ec ) noexcept
@@ -77,7 +278,7 @@ namespace tinydircpp {
 
         void current_path( path const & p )
         {
-            if ( SetCurrentDirectoryW( p.c_str() ) == 0 ) { // failed
+            if ( TINYDIR_SYSCALL( current_directory, SetCurrentDirectoryW( p.c_str() ) ) == 0 ) { // failed
                 FSTHROW( std::errc::no_such_file_or_directory, p );
             }
         }
@@ -89,11 +290,21 @@ namespace tinydircpp {
 
         path abspath( path const & p )
         {
-            wchar_t fullpath[ TINYDIR_PATH_MAX + TINYDIR_PATH_EXTRA ]{};
-            if ( GetFullPathNameW( p.c_str(), TINYDIR_PATH_MAX, fullpath, nullptr ) == 0 ) {
-                FSTHROW_MANUAL( fs::filesystem_error_codes::unknown_io_error, p );
+            // sized by asking first, long paths are not cut at TINYDIR_PATH_MAX. The size is asked again if the
+            // current directory changed in between.
+            std::wstring fullpath( TINYDIR_PATH_MAX, L'\0' );
+            for ( ;; ) {
+                DWORD const size = TINYDIR_SYSCALL( get_full_path_name, GetFullPathNameW( p.c_str(),
+                    static_cast< DWORD >( fullpath.size() ), &fullpath[ 0 ], nullptr ) );
+                if ( size == 0 ) {
+                    FSTHROW_MANUAL( fs::filesystem_error_codes::unknown_io_error, p );
+                }
+                if ( size < fullpath.size() ) { // the terminating null is only counted when it did not fit
+                    fullpath.resize( size );
+                    return path{ fullpath };
+                }
+                fullpath.resize( size );
             }
-            return path{ fullpath };
         }
 
         path basename( path const & p )
@@ -135,8 +346,10 @@ namespace tinydircpp {
 
         void copy( path const & from, path const & to )
         {
+            TINYDIR_TRACE_API( copy );
             BOOL const fail_if_exists = true;
-            BOOL const copying_succeeded = CopyFileW( from.c_str(), to.c_str(), fail_if_exists );
+            BOOL const copying_succeeded = TINYDIR_SYSCALL( copy_file, CopyFileW( from.c_str(), to.c_str(),
+                fail_if_exists ) );
             if ( !copying_succeeded ) {
                 FSTHROW_MANUAL_DPATH( fs::filesystem_error_codes::unknown_io_error, from, to );
             }
@@ -149,32 +362,43 @@ namespace tinydircpp {
 
         bool exists( path const & p )
         {
-            return GetFileAttributesW( p.c_str() ) != INVALID_FILE_ATTRIBUTES;
+            TINYDIR_TRACE_API( exists );
+            return TINYDIR_SYSCALL( get_file_attributes, GetFileAttributesW( p.c_str() ) ) != INVALID_FILE_ATTRIBUTES;
         }
         bool exists( path const & p, std::error_code & ec ) noexcept
         {
-            bool const found = GetFileAttributesW( p.c_str() ) != INVALID_FILE_ATTRIBUTES;
-            if ( !found ) {
-                ec = std::make_error_code( std::errc::no_such_file_or_directory );
+            TINYDIR_TRACE_API( exists );
+            bool const found = TINYDIR_SYSCALL( get_file_attributes,
+                GetFileAttributesW( p.c_str() ) ) != INVALID_FILE_ATTRIBUTES;
+            // a path that isn't there is an answer, not an error; only failing to find out is
+            DWORD const error = found ? ERROR_SUCCESS : GetLastError();
+            if ( error == ERROR_SUCCESS || error == ERROR_FILE_NOT_FOUND || error == ERROR_PATH_NOT_FOUND ) {
+                ec.clear();
+            } else {
+                ec = std::error_code( fs::filesystem_error_codes::handle_not_opened );
             }
             return found;
         }
 
         bool equivalent( path const & a, path const & b )
         {
+            TINYDIR_TRACE_API( equivalent );
             if ( ( !exists( a ) && !exists( b ) ) || ( is_other( a ) && is_other( b ) ) ) {
                 FSTHROW_DPATH( std::errc::no_such_file_or_directory, a, b );
             }
-            details::smart_handle a_file_handle{ CreateFileW( a.c_str(), GENERIC_READ, 0, nullptr, OPEN_EXISTING,
-                FILE_ATTRIBUTE_NORMAL, nullptr ) };
-            details::smart_handle b_file_handle{ CreateFileW( b.c_str(), GENERIC_READ, 0, nullptr, OPEN_EXISTING,
-                FILE_ATTRIBUTE_NORMAL, nullptr ) };
+            // opened for attributes only and shared with everybody, so that files in use and directories work too
+            DWORD const share_all = FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE;
+            details::smart_handle a_file_handle{ TINYDIR_SYSCALL( create_file, CreateFileW( a.c_str(), 0, share_all,
+                nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr ) ) };
+            details::smart_handle b_file_handle{ TINYDIR_SYSCALL( create_file, CreateFileW( b.c_str(), 0, share_all,
+                nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr ) ) };
             if ( !a_file_handle || !b_file_handle )
                 FSTHROW_MANUAL_DPATH( fs::filesystem_error_codes::handle_not_opened, a, b );
             BY_HANDLE_FILE_INFORMATION a_info{}, b_info{};
 
-            if ( GetFileInformationByHandle( a_file_handle, &a_info ) == 0
-                || GetFileInformationByHandle( b_file_handle, &b_info ) == 0 ) {
+            if ( TINYDIR_SYSCALL( get_file_information, GetFileInformationByHandle( a_file_handle, &a_info ) ) == 0
+                || TINYDIR_SYSCALL( get_file_information, GetFileInformationByHandle( b_file_handle,
+                    &b_info ) ) == 0 ) {
                 FSTHROW_MANUAL_DPATH( fs::filesystem_error_codes::unknown_io_error, a, b );
             }
             auto tuple_getter = []( BY_HANDLE_FILE_INFORMATION const & info ) {
@@ -193,7 +417,7 @@ namespace tinydircpp {
 
         void create_hard_link( path const & to, path const & new_hardlink )
         {
-            if ( CreateHardLinkW( new_hardlink.c_str(), to.c_str(), nullptr ) == 0 ) {
+            if ( TINYDIR_SYSCALL( create_link, CreateHardLinkW( new_hardlink.c_str(), to.c_str(), nullptr ) ) == 0 ) {
                 FSTHROW_MANUAL_DPATH( fs::filesystem_error_codes::no_link, to, new_hardlink );
             }
         }
@@ -205,7 +429,9 @@ namespace tinydircpp {
 
         void create_directory( path const & p, path const & existing_path )
         {
-            if ( CreateDirectoryExW( existing_path.c_str(), p.c_str(), nullptr ) == 0 ) {
+            TINYDIR_TRACE_API( create_directory );
+            if ( TINYDIR_SYSCALL( create_directory, CreateDirectoryExW( existing_path.c_str(), p.c_str(),
+                nullptr ) ) == 0 ) {
                 DWORD const last_error = GetLastError();
                 if ( last_error == ERROR_ALREADY_EXISTS ) {
                     return; // not an error
@@ -222,7 +448,8 @@ namespace tinydircpp {
         bool create_directory_symlink( path const & to, path const & new_symlink )
         {
             if ( !is_directory( new_symlink ) ) return false;
-            if ( CreateSymbolicLinkW( new_symlink.c_str(), to.c_str(), SYMBOLIC_LINK_FLAG_DIRECTORY ) == 0 ) {
+            if ( TINYDIR_SYSCALL( create_link, CreateSymbolicLinkW( new_symlink.c_str(), to.c_str(),
+                SYMBOLIC_LINK_FLAG_DIRECTORY ) ) == 0 ) {
                 FSTHROW_MANUAL_DPATH( fs::filesystem_error_codes::no_link, to, new_symlink );
             }
             return true;
@@ -239,7 +466,7 @@ namespace tinydircpp {
             if ( !is_regular_file( new_symlink ) ) {
                 throw;
             }
-            if ( CreateSymbolicLinkW( new_symlink.c_str(), to.c_str(), 0 ) == 0 ) {
+            if ( TINYDIR_SYSCALL( create_link, CreateSymbolicLinkW( new_symlink.c_str(), to.c_str(), 0 ) ) == 0 ) {
                 FSTHROW_MANUAL_DPATH( fs::filesystem_error_codes::no_link, to, new_symlink );
             }
         }
@@ -248,22 +475,18 @@ namespace tinydircpp {
         {
             FSERROR_TRY_CATCH( create_symlink( to, new_symlink ), ec );
         }
-        bool exists( file_status status ) noexcept
-        {
-            return status_known( status ) && ( status.type() != file_type::not_found );
-        }
-
         std::uintmax_t file_size( path const & p )
         {
+            TINYDIR_TRACE_API( file_size );
             if ( !exists( p ) || !is_regular_file( p ) ) return static_cast< std::uintmax_t >( -1 );
 
-            details::smart_handle file_handle{ CreateFileW( p.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
-                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr ) };
+            details::smart_handle file_handle{ TINYDIR_SYSCALL( create_file, CreateFileW( p.c_str(), GENERIC_READ,
+                FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr ) ) };
             if ( !file_handle ) {
                 FSTHROW_MANUAL( fs::filesystem_error_codes::handle_not_opened, p );
             }
             LARGE_INTEGER sizeof_file{};
-            if ( GetFileSizeEx( file_handle, &sizeof_file ) == 0 ) {
+            if ( TINYDIR_SYSCALL( get_file_size, GetFileSizeEx( file_handle, &sizeof_file ) ) == 0 ) {
                 FSTHROW_MANUAL( fs::filesystem_error_codes::could_not_obtain_size, p );
             }
             return sizeof_file.QuadPart;
@@ -278,11 +501,16 @@ namespace tinydircpp {
 
         std::uintmax_t hard_link_count( path const & p )
         {
-            details::smart_handle h{ CreateFileW( p.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
-                FILE_ATTRIBUTE_NORMAL, nullptr ) };
+            TINYDIR_TRACE_API( hard_link_count );
+            // opened for attributes only and shared with everybody, like equivalent(), so directories and files
+            // somebody else is writing to work too
+            details::smart_handle h{ TINYDIR_SYSCALL( create_file, CreateFileW( p.c_str(), 0,
+                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                FILE_FLAG_BACKUP_SEMANTICS, nullptr ) ) };
             if ( !h ) FSTHROW_MANUAL( fs::filesystem_error_codes::handle_not_opened, p );
             BY_HANDLE_FILE_INFORMATION file_information{};
-            if ( GetFileInformationByHandle( h, ( LPBY_HANDLE_FILE_INFORMATION ) &file_information ) == 0 ) {
+            if ( TINYDIR_SYSCALL( get_file_information, GetFileInformationByHandle( h,
+                ( LPBY_HANDLE_FILE_INFORMATION ) &file_information ) ) == 0 ) {
                 FSTHROW_MANUAL( fs::filesystem_error_codes::hardlink_count_error, p );
             }
             return file_information.nNumberOfLinks;
@@ -299,9 +527,44 @@ namespace tinydircpp {
             return is_regular_file( status( p ) );
         }
 
-        bool is_other( file_status s ) noexcept
+        bool is_block_file( path const & p )
+        {
+            return is_block_file( status( p ) );
+        }
+
+        bool is_block_file( path const & p, std::error_code & ec ) noexcept
+        {
+            return is_block_file( status( p, ec ) );
+        }
+
+        bool is_character_file( path const & p )
+        {
+            return is_character_file( status( p ) );
+        }
+
+        bool is_character_file( path const & p, std::error_code & ec ) noexcept
         {
-            return exists( s ) && !is_regular_file( s ) && !is_directory( s ) && !is_symlink( s );
+            return is_character_file( status( p, ec ) );
+        }
+
+        bool is_fifo( path const & p )
+        {
+            return is_fifo( status( p ) );
+        }
+
+        bool is_fifo( path const & p, std::error_code & ec ) noexcept
+        {
+            return is_fifo( status( p, ec ) );
+        }
+
+        bool is_socket( path const & p )
+        {
+            return is_socket( status( p ) );
+        }
+
+        bool is_socket( path const & p, std::error_code & ec ) noexcept
+        {
+            return is_socket( status( p, ec ) );
         }
 
         bool is_other( path const & p )
@@ -315,22 +578,12 @@ namespace tinydircpp {
             return true;
         }
 
-        bool is_regular_file( file_status status ) noexcept
-        {
-            return status.type() == file_type::regular;
-        }
-
         bool is_regular_file( path const & p, std::error_code & ec ) noexcept
         {
             FSERROR_TRY_CATCH( return is_regular_file( p ), ec );
             return false;
         }
 
-        bool is_directory( file_status s ) noexcept
-        {
-            return s.type() == file_type::directory;
-        }
-
         bool is_directory( path const & p )
         {
             return is_directory( status( p ) );
@@ -363,18 +616,12 @@ namespace tinydircpp {
             }
             return st;
         }
-        /*
-        none = 0,
-        block,
-        character,
-        fifo,
-        socket,
-        unknown
-    */
-    // to-do: determine the rest of the file type
+        // AF_UNIX sockets are told apart by their reparse tag; nothing on a Windows volume is a block or character
+        // device or a fifo, those types only come in through status_from_mode
         file_status status( path const & p, std::error_code & ec ) noexcept
         {
-            DWORD const file_attrib = GetFileAttributesW( p.c_str() );
+            TINYDIR_TRACE_API( status );
+            DWORD const file_attrib = TINYDIR_SYSCALL( get_file_attributes, GetFileAttributesW( p.c_str() ) );
             if ( file_attrib == INVALID_FILE_ATTRIBUTES ) {
                 ec = std::error_code( fs::filesystem_error_codes::handle_not_opened );
                 return file_status{ file_type::not_found };
@@ -382,27 +629,16 @@ namespace tinydircpp {
             ec.clear();
             if ( file_attrib & FILE_ATTRIBUTE_REPARSE_POINT ) {
                 WIN32_FIND_DATAW find_data{};
-                HANDLE symlink_handle = FindFirstFileW( p.c_str(), &find_data ); // not destructible by CloseHandle
+                // not destructible by CloseHandle
+                HANDLE symlink_handle = TINYDIR_SYSCALL( find_first_file, FindFirstFileW( p.c_str(), &find_data ) );
                 if ( symlink_handle == INVALID_HANDLE_VALUE ) {
                     ec = std::error_code( fs::filesystem_error_codes::handle_not_opened );
                     return file_status{ file_type::unknown };
                 }
-                if ( find_data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT
-                    && IsReparseTagMicrosoft( find_data.dwReserved0 )
-                    && find_data.dwReserved0 == IO_REPARSE_TAG_SYMLINK ) {
-                    FindClose( symlink_handle );
-                    return file_status{ file_type::symlink };
-                }
                 FindClose( symlink_handle );
-                return file_status{ file_type::unknown };
-            } else if ( file_attrib & FILE_ATTRIBUTE_DIRECTORY ) {
-                return file_status{ file_type::directory };
+                return details::status_from_attributes( find_data.dwFileAttributes, find_data.dwReserved0 );
             }
-            return file_status{ file_type::regular };
-        }
-        bool status_known( file_status s ) noexcept
-        {
-            return s.type() != file_type::none;
+            return details::status_from_attributes( file_attrib, 0 );
         }
         file_status symlink_status( path const & p )
         {
@@ -418,17 +654,22 @@ namespace tinydircpp {
 
         path temporary_directory_path()
         {
-            wchar_t temp_path[ TINYDIR_PATH_MAX + 2 ]{};
-            DWORD path_length = GetTempPathW( TINYDIR_PATH_MAX, temp_path );
-            if ( path_length == 0 ) {
-                FSTHROW( std::errc::filename_too_long, {} );
-            } else if ( path_length > TINYDIR_PATH_MAX ) { // rare, but this is my fault, didn't allocate enough space
-                std::string new_path( path_length, ' ' );
-                path_length = GetTempPathA( path_length, ( LPSTR ) &new_path[ 0 ] );
-                return path{ new_path };
+            // sized by asking first, like abspath(); the size is asked again should TMP change in between
+            std::wstring temp_path( TINYDIR_PATH_MAX, L'\0' );
+            for ( ;; ) {
+                DWORD const size = TINYDIR_SYSCALL( get_temp_path,
+                    GetTempPathW( static_cast< DWORD >( temp_path.size() ), &temp_path[ 0 ] ) );
+                if ( size == 0 ) {
+                    FSTHROW_MANUAL( fs::filesystem_error_codes::unknown_io_error, path{} );
+                }
+                if ( size < temp_path.size() ) {
+                    temp_path.resize( size );
+                    return path{ temp_path };
+                }
+                temp_path.resize( size );
             }
-            return path{ temp_path };
         }
+
         path temporary_directory_path( std::error_code & ec ) noexcept
         {
             FSERROR_TRY_CATCH( return temporary_directory_path(), ec );
@@ -440,6 +681,31 @@ namespace tinydircpp {
             return a.native() == b.native() || fs::equivalent( a, b );
         }
 
+        path unique_path( path const & model )
+        {
+            static wchar_t const hex_digits[] = L"0123456789abcdef";
+            std::wstring name = model.native();
+            std::uint64_t bits = 0;
+            std::size_t bits_left = 0;
+            for ( auto & c : name ) {
+                if ( c != L'%' ) continue;
+                if ( bits_left == 0 ) {
+                    bits = details::thread_random();
+                    bits_left = 16;
+                }
+                c = hex_digits[ bits & 0xF ];
+                bits >>= 4;
+                --bits_left;
+            }
+            return path{ name };
+        }
+
+        path unique_path( path const & model, std::error_code & ec ) noexcept
+        {
+            FSERROR_TRY_CATCH( return unique_path( model ), ec );
+            return path{};
+        }
+
         void copy_symlink( path const & existing_symlink, path const & new_symlink )
         {
             create_symlink( read_symlink( existing_symlink ), new_symlink );
@@ -452,7 +718,8 @@ namespace tinydircpp {
 
         bool create_directories( path const & p )
         {
-            int const result = SHCreateDirectoryExW( nullptr, p.c_str(), nullptr );
+            TINYDIR_TRACE_API( create_directories );
+            int const result = TINYDIR_SYSCALL( create_directory, SHCreateDirectoryExW( nullptr, p.c_str(), nullptr ) );
             switch ( result ) {
             case ERROR_SUCCESS:
             case ERROR_FILE_EXISTS:
@@ -478,11 +745,6 @@ namespace tinydircpp {
             return false;
         }
 
-        bool is_symlink( file_status s ) noexcept
-        {
-            return s.type() == file_type::symlink;
-        }
-
         bool is_symlink( path const & p )
         {
             return is_symlink( status( p ) );
@@ -495,9 +757,11 @@ namespace tinydircpp {
 
         file_time_type last_write_time( path const & p )
         {
+            TINYDIR_TRACE_API( last_write_time );
             wchar_t const *fp_path = p.c_str();
             WIN32_FILE_ATTRIBUTE_DATA file_data{};
-            if ( GetFileAttributesExW( fp_path, GetFileExInfoStandard, &file_data ) == 0 ) {
+            if ( TINYDIR_SYSCALL( get_file_attributes, GetFileAttributesExW( fp_path, GetFileExInfoStandard,
+                &file_data ) ) == 0 ) {
                 FSTHROW_MANUAL( fs::filesystem_error_codes::could_not_obtain_time, p );
             }
             return fs::details::Win32FiletimeToChronoTime( file_data.ftLastWriteTime );
@@ -511,13 +775,15 @@ namespace tinydircpp {
 
         void set_last_write_time( path const & p, file_time_type new_time )
         {
-            details::smart_handle file_handle{ CreateFileW( p.c_str(), GENERIC_WRITE, 0,
-                nullptr, OPEN_EXISTING, FILE_WRITE_ATTRIBUTES | FILE_ATTRIBUTE_NORMAL, nullptr ) };
+            TINYDIR_TRACE_API( set_last_write_time );
+            details::smart_handle file_handle{ TINYDIR_SYSCALL( create_file, CreateFileW( p.c_str(), GENERIC_WRITE, 0,
+                nullptr, OPEN_EXISTING, FILE_WRITE_ATTRIBUTES | FILE_ATTRIBUTE_NORMAL, nullptr ) ) };
             if ( !file_handle ) {
                 FSTHROW_MANUAL( fs::filesystem_error_codes::handle_not_opened, p );
             }
             FILETIME const win32_filetime = fs::details::ChronoTimeToWin32Filetime( new_time );
-            if ( SetFileTime( file_handle, nullptr, nullptr, &win32_filetime ) == 0 ) {
+            if ( TINYDIR_SYSCALL( set_file_time, SetFileTime( file_handle, nullptr, nullptr,
+                &win32_filetime ) ) == 0 ) {
                 FSTHROW_MANUAL( fs::filesystem_error_codes::set_filetime_error, p );
             }
         }
@@ -529,8 +795,10 @@ namespace tinydircpp {
 
         file_time_type last_access_time( path const & p )
         {
+            TINYDIR_TRACE_API( last_access_time );
             WIN32_FILE_ATTRIBUTE_DATA file_metadata{};
-            if ( GetFileAttributesExW( p.c_str(), GetFileExInfoStandard, &file_metadata ) == 0 ) {
+            if ( TINYDIR_SYSCALL( get_file_attributes, GetFileAttributesExW( p.c_str(), GetFileExInfoStandard,
+                &file_metadata ) ) == 0 ) {
                 FSTHROW_MANUAL( fs::filesystem_error_codes::could_not_obtain_time, p );
             }
             return details::Win32FiletimeToChronoTime( file_metadata.ftLastAccessTime );
@@ -544,13 +812,14 @@ namespace tinydircpp {
 
         void set_last_access_time( path const & p, file_time_type new_time )
         {
-            details::smart_handle file_handle{ CreateFileW( p.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr,
-                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr ) };
+            TINYDIR_TRACE_API( set_last_access_time );
+            details::smart_handle file_handle{ TINYDIR_SYSCALL( create_file, CreateFileW( p.c_str(),
+                GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr ) ) };
             if ( !file_handle ) {
                 FSTHROW_MANUAL( fs::filesystem_error_codes::handle_not_opened, p );
             }
             auto const access_time = details::ChronoTimeToWin32Filetime( new_time );
-            if ( SetFileTime( file_handle, nullptr, &access_time, nullptr ) == 0 ) {
+            if ( TINYDIR_SYSCALL( set_file_time, SetFileTime( file_handle, nullptr, &access_time, nullptr ) ) == 0 ) {
                 FSTHROW_MANUAL( fs::filesystem_error_codes::set_filetime_error, p );
             }
         }
@@ -562,8 +831,10 @@ namespace tinydircpp {
 
         file_time_type creation_time( path const & p )
         {
+            TINYDIR_TRACE_API( creation_time );
             WIN32_FILE_ATTRIBUTE_DATA file_data{};
-            if ( GetFileAttributesExW( p.c_str(), GetFileExInfoStandard, &file_data ) == 0 ) {
+            if ( TINYDIR_SYSCALL( get_file_attributes, GetFileAttributesExW( p.c_str(), GetFileExInfoStandard,
+                &file_data ) ) == 0 ) {
                 FSTHROW_MANUAL( fs::filesystem_error_codes::could_not_obtain_time, p );
             }
             return fs::details::Win32FiletimeToChronoTime( file_data.ftCreationTime );
@@ -577,13 +848,14 @@ namespace tinydircpp {
 
         void set_creation_time( path const & p, file_time_type new_time )
         {
-            details::smart_handle file_handle{ CreateFileW( p.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr,
-                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr ) };
+            TINYDIR_TRACE_API( set_creation_time );
+            details::smart_handle file_handle{ TINYDIR_SYSCALL( create_file, CreateFileW( p.c_str(),
+                GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr ) ) };
             if ( !file_handle ) {
                 FSTHROW_MANUAL( fs::filesystem_error_codes::handle_not_opened, p );
             }
             auto const creation_time = details::ChronoTimeToWin32Filetime( new_time );
-            if ( SetFileTime( file_handle, &creation_time, nullptr, nullptr ) == 0 ) {
+            if ( TINYDIR_SYSCALL( set_file_time, SetFileTime( file_handle, &creation_time, nullptr, nullptr ) ) == 0 ) {
                 FSTHROW_MANUAL( fs::filesystem_error_codes::set_filetime_error, p );
             }
         }
@@ -612,10 +884,11 @@ namespace tinydircpp {
 
         path read_symlink( path const & p )
         {
+            TINYDIR_TRACE_API( read_symlink );
             if ( !is_symlink( p ) ) return path{};
 
-            details::smart_handle h{ CreateFileW( p.c_str(), GENERIC_READ, 0, nullptr, OPEN_EXISTING,
-                FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OPEN_REPARSE_POINT , nullptr ) };
+            details::smart_handle h{ TINYDIR_SYSCALL( create_file, CreateFileW( p.c_str(), GENERIC_READ, 0, nullptr,
+                OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OPEN_REPARSE_POINT , nullptr ) ) };
             if ( !h ) {
                 FSTHROW_MANUAL( fs::filesystem_error_codes::handle_not_opened, p );
             }
@@ -625,10 +898,11 @@ namespace tinydircpp {
                 char abyss[ offsetof( fs::REPARSE_DATA_BUFFER, GenericReparseBuffer ) + ( 1024 * 16 ) ];
                 fs::REPARSE_DATA_BUFFER reparse_buffer;
             } ai; // borrowed from boost::filesystem
-            if ( DeviceIoControl( h, FSCTL_GET_REPARSE_POINT, nullptr, 0, &ai.reparse_buffer, sizeof( anon_info ),
-                &returned_data_size, nullptr ) == 0 ) {
+            if ( TINYDIR_SYSCALL( device_io_control, DeviceIoControl( h, FSCTL_GET_REPARSE_POINT, nullptr, 0,
+                &ai.reparse_buffer, sizeof( anon_info ), &returned_data_size, nullptr ) ) == 0 ) {
                 FSTHROW_MANUAL( fs::filesystem_error_codes::unknown_io_error, p );
             }
+            TINYDIR_COUNT_BYTES( read_symlink, returned_data_size );
             std::wstring target_name{ static_cast< wchar_t* >( ai.reparse_buffer.SymbolicLinkReparseBuffer.PathBuffer )
                 + ai.reparse_buffer.SymbolicLinkReparseBuffer.PrintNameOffset / 2,
                 static_cast< wchar_t* >( ai.reparse_buffer.SymbolicLinkReparseBuffer.PathBuffer )
@@ -643,14 +917,95 @@ namespace tinydircpp {
             return path{};
         }
 
+        void permissions( path const & p, perms prms, permissions_status how )
+        {
+            TINYDIR_TRACE_API( permissions );
+            if ( ( static_cast< int >( how ) & static_cast< int >( permissions_status::follow_symlinks ) ) != 0 ) {
+                // a handle opened without FILE_FLAG_OPEN_REPARSE_POINT is the target's; zeroed times stay as they are
+                details::smart_handle handle{ TINYDIR_SYSCALL( create_file, CreateFileW( p.c_str(),
+                    FILE_READ_ATTRIBUTES | FILE_WRITE_ATTRIBUTES,
+                    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                    FILE_FLAG_BACKUP_SEMANTICS, nullptr ) ) };
+                if ( !handle ) {
+                    FSTHROW_MANUAL( fs::filesystem_error_codes::handle_not_opened, p );
+                }
+                FILE_BASIC_INFO basic_info{};
+                if ( TINYDIR_SYSCALL( get_file_information, GetFileInformationByHandleEx( handle, FileBasicInfo,
+                    &basic_info, sizeof( basic_info ) ) ) == 0 ) {
+                    FSTHROW_MANUAL( fs::filesystem_error_codes::unknown_io_error, p );
+                }
+                DWORD const wanted = details::attributes_with_perms( basic_info.FileAttributes, prms, how );
+                if ( wanted == basic_info.FileAttributes ) return;
+                basic_info = FILE_BASIC_INFO{};
+                basic_info.FileAttributes = wanted == 0 ? FILE_ATTRIBUTE_NORMAL : wanted;
+                if ( TINYDIR_SYSCALL( set_file_information, SetFileInformationByHandle( handle, FileBasicInfo,
+                    &basic_info, sizeof( basic_info ) ) ) == 0 ) {
+                    FSTHROW_MANUAL( fs::filesystem_error_codes::unknown_io_error, p );
+                }
+                return;
+            }
+            DWORD const file_attrib = TINYDIR_SYSCALL( get_file_attributes, GetFileAttributesW( p.c_str() ) );
+            if ( file_attrib == INVALID_FILE_ATTRIBUTES ) {
+                FSTHROW_MANUAL( fs::filesystem_error_codes::handle_not_opened, p );
+            }
+            DWORD const wanted = details::attributes_with_perms( file_attrib, prms, how );
+            if ( wanted == file_attrib ) return;
+            if ( TINYDIR_SYSCALL( set_file_attributes, SetFileAttributesW( p.c_str(),
+                wanted == 0 ? FILE_ATTRIBUTE_NORMAL : wanted ) ) == 0 ) {
+                FSTHROW_MANUAL( fs::filesystem_error_codes::unknown_io_error, p );
+            }
+        }
+
+        void permissions( path const & p, perms prms, permissions_status how, std::error_code & ec ) noexcept
+        {
+            FSERROR_TRY_CATCH( permissions( p, prms, how ), ec );
+        }
+
+        void rename( path const & old_p, path const & new_p )
+        {
+            TINYDIR_TRACE_API( rename );
+            if ( TINYDIR_SYSCALL( move_file, MoveFileExW( old_p.c_str(), new_p.c_str(),
+                MOVEFILE_REPLACE_EXISTING ) ) == 0 ) {
+                FSTHROW_MANUAL_DPATH( fs::filesystem_error_codes::unknown_io_error, old_p, new_p );
+            }
+        }
+
+        void rename( path const & old_p, path const & new_p, std::error_code & ec ) noexcept
+        {
+            FSERROR_TRY_CATCH( rename( old_p, new_p ), ec );
+        }
+
+        void sync( path const & p )
+        {
+            TINYDIR_TRACE_API( sync );
+            // directories only open with backup semantics, and only a handle with write access may be flushed
+            details::smart_handle handle{ TINYDIR_SYSCALL( create_file, CreateFileW( p.c_str(), GENERIC_WRITE,
+                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                FILE_FLAG_BACKUP_SEMANTICS, nullptr ) ) };
+            if ( !handle ) {
+                FSTHROW_MANUAL( fs::filesystem_error_codes::handle_not_opened, p );
+            }
+            if ( TINYDIR_SYSCALL( flush_file_buffers, FlushFileBuffers( handle ) ) == 0 ) {
+                FSTHROW_MANUAL( fs::filesystem_error_codes::unknown_io_error, p );
+            }
+        }
+
+        void sync( path const & p, std::error_code & ec ) noexcept
+        {
+            FSERROR_TRY_CATCH( sync( p ), ec );
+        }
+
         void resize_file( path const & p, std::uintmax_t new_size )
         {
-            details::smart_handle file_handle{ CreateFileW( p.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
-                nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr ) };
+            TINYDIR_TRACE_API( resize_file );
+            details::smart_handle file_handle{ TINYDIR_SYSCALL( create_file, CreateFileW( p.c_str(),
+                GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                nullptr ) ) };
             if ( !file_handle ) {
                 FSTHROW_MANUAL( fs::filesystem_error_codes::handle_not_opened, p );
             }
-            if ( SetFilePointer( file_handle, ( LONG ) new_size, nullptr, FILE_BEGIN ) == INVALID_SET_FILE_POINTER ) {
+            if ( TINYDIR_SYSCALL( set_file_pointer, SetFilePointer( file_handle, ( LONG ) new_size, nullptr,
+                FILE_BEGIN ) ) == INVALID_SET_FILE_POINTER ) {
                 FSTHROW_MANUAL( fs::filesystem_error_codes::invalid_set_file_pointer, p );
             }
         }
@@ -662,15 +1017,16 @@ namespace tinydircpp {
 
         space_info space( path const & p )
         {
+            TINYDIR_TRACE_API( space );
             wchar_t const *directory_name = p.c_str();
-            details::smart_handle disk_handle{ CreateFileW( directory_name, 0, FILE_SHARE_READ | FILE_SHARE_WRITE,
-                nullptr, OPEN_EXISTING, 0, nullptr ) };
+            details::smart_handle disk_handle{ TINYDIR_SYSCALL( create_file, CreateFileW( directory_name, 0,
+                FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, 0, nullptr ) ) };
             if ( !disk_handle ) {
                 FSTHROW_MANUAL( fs::filesystem_error_codes::handle_not_opened, p );
             }
             ULARGE_INTEGER free_bytes_available_to_caller{}, total_bytes{}, total_free_bytes{};
-            if ( GetDiskFreeSpaceExW( directory_name, &free_bytes_available_to_caller,
-                &total_bytes, &total_free_bytes ) == 0 ) {
+            if ( TINYDIR_SYSCALL( get_disk_free_space, GetDiskFreeSpaceExW( directory_name,
+                &free_bytes_available_to_caller, &total_bytes, &total_free_bytes ) ) == 0 ) {
                 FSTHROW_MANUAL( fs::filesystem_error_codes::could_not_obtain_size, p );
             }
             fs::space_info disk_space_info{};
@@ -696,6 +1052,8 @@ namespace tinydircpp {
             path_ = p;
             status_ = st;
             symlink_status_ = sym_link;
+            file_size_ = static_cast< std::uintmax_t >( -1 );
+            last_write_time_ = file_time_type{};
         }
         // to-do
         void directory_entry::replace_filename( fs::path const & p, file_status st, file_status sym_link )
@@ -730,6 +1088,30 @@ namespace tinydircpp {
             }
             return symlink_status_;
         }
+
+        std::uintmax_t directory_entry::file_size() const
+        {
+            if ( file_size_ == static_cast< std::uintmax_t >( -1 ) ) {
+                file_size_ = fs::file_size( path_ );
+            }
+            return file_size_;
+        }
+
+        file_time_type directory_entry::last_write_time() const
+        {
+            if ( last_write_time_ == file_time_type{} ) {
+                last_write_time_ = fs::last_write_time( path_ );
+            }
+            return last_write_time_;
+        }
+
+        void directory_entry::refresh() noexcept
+        {
+            status_ = file_status{};
+            symlink_status_ = file_status{};
+            file_size_ = static_cast< std::uintmax_t >( -1 );
+            last_write_time_ = file_time_type{};
+        }
         bool directory_entry::operator<( directory_entry const & rhs ) const
         {
             return path_ < rhs.path_;
@@ -760,31 +1142,54 @@ namespace tinydircpp {
             return !( *this < rhs );
         }
 
-        directory_iterator::directory_iterator( path const & p ) noexcept : full_path{ p }, entry{},
-            search_handle{ INVALID_HANDLE_VALUE }
+        directory_iterator::directory_iterator( path const & p, std::size_t prefetch_count ) noexcept
         {
+            TINYDIR_TRACE_API( directory_iteration );
             WIN32_FIND_DATAW find_data{};
-            if ( full_path.native().back() != L'*' ) {
-                search_handle = FindFirstFileW( ( full_path / path{ "\\*" } ).c_str(), &find_data );
-            } else {
-                search_handle = FindFirstFileW( full_path.c_str(), &find_data );
+            path const pattern{ p.native().back() != L'*' ? p / path{ "\\*" } : p };
+            // FindExInfoBasic skips the short 8.3 names we never use, LARGE_FETCH reads the directory in bigger chunks
+            HANDLE const search_handle = TINYDIR_SYSCALL( find_first_file, FindFirstFileExW( pattern.c_str(),
+                FindExInfoBasic, &find_data, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH ) );
+            if ( search_handle == INVALID_HANDLE_VALUE ) return;
+
+            bool found = true;
+            while ( details::is_dot_or_dotdot( find_data.cFileName )
+                && ( found = ( TINYDIR_SYSCALL( find_next_file, FindNextFileW( search_handle, &find_data ) ) != 0 ) ) );
+            if ( !found ) {
+                FindClose( search_handle );
+                return;
             }
-            if ( search_handle != INVALID_HANDLE_VALUE ) {
-                while ( ( std::wcscmp( find_data.cFileName, L"." ) == 0
-                    || std::wcscmp( find_data.cFileName, L".." ) == 0 )
-                    && FindNextFileW( search_handle, &find_data ) != 0 );
-                entry.assign( full_path / path{ find_data.cFileName } );
+            try {
+                state = std::make_shared<details::directory_iteration_state>( p );
+                state->search_handle = search_handle;
+                state->entry = details::make_directory_entry( p, find_data );
+            } catch ( std::exception const & ) {
+                if ( !state ) FindClose( search_handle );
+                state.reset();
+                return;
+            }
+            if ( prefetch_count > 0 ) {
+                try {
+                    state->prefetcher = std::make_unique<details::directory_prefetcher>( search_handle, p,
+                        prefetch_count );
+                } catch ( std::exception const & ) { // carry on without the read-ahead
+                    state->prefetcher.reset();
+                }
             }
         }
+
         directory_entry const & directory_iterator::operator*() const
         {
-            return entry;
+            static directory_entry const past_the_end{};
+            return state ? state->entry : past_the_end;
         }
 
         // directory_iterator must satisfy the requirements for input iterator
         bool directory_iterator::operator==( directory_iterator const & iter ) const
         {
-            return ( search_handle == iter.search_handle ) && ( entry == iter.entry );
+            bool const at_end = !state || state->done;
+            bool const iter_at_end = !iter.state || iter.state->done;
+            return ( at_end && iter_at_end ) || ( !at_end && state == iter.state );
         }
 
         bool directory_iterator::operator != ( directory_iterator const & iter ) const
@@ -794,24 +1199,32 @@ namespace tinydircpp {
 
         directory_iterator& directory_iterator::operator++()
         {
-            if ( search_handle != INVALID_HANDLE_VALUE ) {
-                WIN32_FIND_DATAW find_data{};
-                if ( FindNextFileW( search_handle, &find_data ) != 0 ) {
-                    while ( ( std::wcscmp( find_data.cFileName, L"." ) == 0
-                        || std::wcscmp( find_data.cFileName, L".." ) == 0 )
-                        && FindNextFileW( search_handle, &find_data ) != 0 );
-                    entry.assign( full_path / path{ find_data.cFileName } );
-                } else {
-                    FindClose( search_handle );
-                    search_handle = INVALID_HANDLE_VALUE;
-                    entry.assign( path{} );
-                }
-            } else {
-                entry = path{};
+            TINYDIR_TRACE_API( directory_iteration );
+            if ( !state ) return *this;
+            {
+                std::lock_guard<std::mutex> lock{ state->mutex };
+                if ( !state->done ) state->advance();
             }
+            if ( state->done ) state.reset();
             return *this;
         }
 
+        bool directory_iterator::split( std::vector<directory_entry> & chunk, std::size_t max_entries )
+        {
+            TINYDIR_TRACE_API( directory_iteration );
+            chunk.clear();
+            if ( !state ) return false;
+            {
+                std::lock_guard<std::mutex> lock{ state->mutex };
+                while ( !state->done && chunk.size() < max_entries ) {
+                    chunk.push_back( std::move( state->entry ) );
+                    state->advance();
+                }
+            }
+            if ( state->done ) state.reset();
+            return !chunk.empty();
+        }
+
         directory_iterator& directory_iterator::begin() noexcept
         {
             return *this;
@@ -66,9 +66,19 @@ constexpr unsigned int TINYDIR_FILENAME_MAX = 256;
 namespace tinydircpp {
     namespace fs
     {
+        class directory_entry;
+        namespace details {
+            class directory_prefetcher;
+            struct directory_iteration_state;
+            directory_entry make_directory_entry( path const & parent, WIN32_FIND_DATAW const & find_data );
+        }
+
         class file_status {
         public:
-            explicit file_status( file_type ft = file_type::none, perms permission = perms::none ) noexcept;
+            constexpr explicit file_status( file_type ft = file_type::none, perms permission = perms::none ) noexcept :
+                ft_{ ft }, permission_{ permission }
+            {
+            }
             //file_status( file_status const & ) noexcept = default;
             //file_status( file_status && ) noexcept = default;
             //~file_status() = default;
@@ -77,12 +87,29 @@ namespace tinydircpp {
             void type( file_type ) noexcept;
             perms permission() const noexcept { return permission_; }
             void  permission( perms ) noexcept;
+            // any of the types in mask, e.g. s.is( file_type_mask::regular | file_type_mask::symlink )
+            constexpr bool is( file_type_mask mask ) const noexcept
+            {
+                return ( type_mask( ft_ ) & mask ) != file_type_mask{};
+            }
             friend bool operator==( file_status const &, file_status const & );
         private:
             file_type ft_;
             perms permission_;
         };
 
+        constexpr file_status status_from_mode( unsigned mode ) noexcept
+        {
+            return file_status{ type_from_mode( mode ), perms_from_mode( mode ) };
+        }
+
+        namespace details {
+            file_status status_from_attributes( DWORD file_attrib, DWORD reparse_tag ) noexcept;
+            // the attributes that give an entry holding file_attrib the permissions prms, applied as how says
+            DWORD attributes_with_perms( DWORD file_attrib, perms prms, permissions_status how ) noexcept;
+            bool is_dot_or_dotdot( wchar_t const * filename ) noexcept;
+        }
+
         class directory_entry {
             using file_path = path;
         public:
@@ -101,6 +128,10 @@ namespace tinydircpp {
             file_path path() const noexcept;
             file_status status() const noexcept;
             file_status symlink_status() const;
+            // both are cached from the directory listing when the entry comes from a directory_iterator
+            std::uintmax_t file_size() const;
+            file_time_type last_write_time() const;
+            void refresh() noexcept;
 
             bool operator<( directory_entry const & ) const;
             bool operator<=( directory_entry const & ) const;
@@ -110,21 +141,29 @@ namespace tinydircpp {
             bool operator>=( directory_entry const & ) const;
 
         private:
+            friend directory_entry details::make_directory_entry( fs::path const &, WIN32_FIND_DATAW const & );
+
             file_path path_ {};
             mutable file_status status_ {};
             mutable file_status symlink_status_ {};
+            mutable std::uintmax_t file_size_ = static_cast< std::uintmax_t >( -1 );
+            mutable file_time_type last_write_time_ {};
         };
 
+        // copies share one enumeration, as with std::filesystem: copying is cheap, and advancing any copy advances
+        // them all. An iterator compares equal to end() once its enumeration is exhausted, whichever copy got it there.
         class directory_iterator : public std::iterator<std::input_iterator_tag, directory_entry>
         {
-            //std::error_code error_code{};
-            path full_path{};
-            mutable directory_entry entry{};
-            HANDLE search_handle{ INVALID_HANDLE_VALUE };
+            // null for the end iterator, closes the search handle when the last copy is gone
+            std::shared_ptr<details::directory_iteration_state> state{};
         public:
             directory_iterator() = default;
-            directory_iterator( path const & p ) noexcept;
+            directory_iterator( path const & p ) noexcept : directory_iterator{ p, 0 }{}
             directory_iterator( path const & p, std::error_code & ec ) noexcept : directory_iterator{ p }{}
+            // prefetch_count > 0 enumerates the next batch of entries on a background task while the caller is still
+            // processing the current batch. Their status comes from the listing like without it: reparse points are
+            // told apart by their tag, their targets are not looked up.
+            directory_iterator( path const & p, std::size_t prefetch_count ) noexcept;
             
             directory_entry const & operator*() const;
             // directory_iterator must satisfy the requirements for input iterator
@@ -135,6 +174,11 @@ namespace tinydircpp {
             directory_iterator end() noexcept;
             directory_iterator const & cbegin() const;
             directory_iterator const cend() const;
+
+            // hands out the entries not visited yet in disjoint chunks of up to max_entries, starting with the
+            // current one. Unlike operator++ it may be called on copies of one iterator from any number of threads
+            // at once, to work through a huge directory in parallel. Returns false once nothing is left.
+            bool split( std::vector<directory_entry> & chunk, std::size_t max_entries = 1024 );
         };
 
         path current_path();
@@ -196,7 +240,10 @@ namespace tinydircpp {
         void create_symlink( path const & to, path const & new_symlink );
         void create_symlink( path const & to, path const & new_symlink, std::error_code & ec ) noexcept;
 
-        bool exists( file_status s ) noexcept;
+        constexpr bool exists( file_status s ) noexcept
+        {
+            return s.is( file_type_mask::exists );
+        }
         bool exists( path const & p );
         bool exists( path const & p, std::error_code & ec ) noexcept;
 
@@ -209,38 +256,62 @@ namespace tinydircpp {
         std::uintmax_t hard_link_count( path const & p );
         std::uintmax_t hard_link_count( path const & p, std::error_code & ec ) noexcept;
 
-        //bool is_block_file( file_status s ) noexcept;
-        //bool is_block_file( path const & p );
-        //bool is_block_file( path const & p, std::error_code & ec ) noexcept;
+        constexpr bool is_block_file( file_status s ) noexcept
+        {
+            return s.is( file_type_mask::block );
+        }
+        bool is_block_file( path const & p );
+        bool is_block_file( path const & p, std::error_code & ec ) noexcept;
 
-        //bool is_character_file( file_status s ) noexcept;
-        //bool is_character_file( path const & p );
-        //bool is_character_file( path const & p, std::error_code & ec ) noexcept;
+        constexpr bool is_character_file( file_status s ) noexcept
+        {
+            return s.is( file_type_mask::character );
+        }
+        bool is_character_file( path const & p );
+        bool is_character_file( path const & p, std::error_code & ec ) noexcept;
 
-        bool is_directory( file_status s ) noexcept;
+        constexpr bool is_directory( file_status s ) noexcept
+        {
+            return s.is( file_type_mask::directory );
+        }
         bool is_directory( path const & p );
         bool is_directory( path const & p, std::error_code & ec ) noexcept;
 
         bool is_empty( path const & p );
         bool is_empty( path const & p, std::error_code & ec ) noexcept;
 
-        /*bool is_fifo( file_status s ) noexcept;
+        constexpr bool is_fifo( file_status s ) noexcept
+        {
+            return s.is( file_type_mask::fifo );
+        }
         bool is_fifo( path const & p );
         bool is_fifo( path const & p, std::error_code & ec ) noexcept;
-        */
-        bool is_other( file_status s ) noexcept;
+
+        constexpr bool is_other( file_status s ) noexcept
+        {
+            return s.is( file_type_mask::other );
+        }
         bool is_other( path const & p );
         bool is_other( path const & p, std::error_code & ec ) noexcept;
 
-        bool is_regular_file( file_status s ) noexcept;
+        constexpr bool is_regular_file( file_status s ) noexcept
+        {
+            return s.is( file_type_mask::regular );
+        }
         bool is_regular_file( path const & p );
         bool is_regular_file( path const & p, std::error_code & ec ) noexcept;
 
-        /*bool is_socket( file_status s ) noexcept;
+        constexpr bool is_socket( file_status s ) noexcept
+        {
+            return s.is( file_type_mask::socket );
+        }
         bool is_socket( path const & p );
         bool is_socket( path const & p, std::error_code & ec ) noexcept;
-        */
-        bool is_symlink( file_status s ) noexcept;
+
+        constexpr bool is_symlink( file_status s ) noexcept
+        {
+            return s.is( file_type_mask::symlink );
+        }
         bool is_symlink( path const & p );
         bool is_symlink( path const & p, std::error_code & ec ) noexcept;
 
@@ -263,8 +334,11 @@ namespace tinydircpp {
         bool is_relative_path( path const & p );
         bool is_abs( path const & p );
 
-        //void permissions( path const & p, perms perm );
-        //void permissions( path const & p, perms perm, std::error_code & ec ) noexcept;
+        // Windows keeps a single read-only attribute where POSIX has nine bits: taking every write bit away sets it,
+        // leaving any one of them clears it. The attribute of a symlink itself is changed, not its target's, unless
+        // how has permissions_status::follow_symlinks.
+        void permissions( path const & p, perms prms, permissions_status how = permissions_status::replace_bits );
+        void permissions( path const & p, perms prms, permissions_status how, std::error_code & ec ) noexcept;
 
         path read_symlink( path const & p );
         path read_symlink( path const & p, std::error_code & ec ) noexcept;
@@ -275,8 +349,9 @@ namespace tinydircpp {
         //std::uintmax_t remove_all( path const & p );
         //std::uintmax_t remove_all( path const & p, std::error_code &ec ) noexcept;
 
-        //void rename( path const & p, perms perm );
-        //void rename( path const & p, perms perm, std::error_code & ec ) noexcept;
+        // replaces new_p if it exists, atomically as far as other processes can tell
+        void rename( path const & old_p, path const & new_p );
+        void rename( path const & old_p, path const & new_p, std::error_code & ec ) noexcept;
 
         void resize_file( path const & p, std::uintmax_t new_size );
         void resize_file( path const & p, std::uintmax_t new_size, std::error_code & ec ) noexcept;
@@ -287,11 +362,18 @@ namespace tinydircpp {
         file_status status( path const & p );
         file_status status( path const & p, std::error_code & ec ) noexcept;
 
-        bool status_known( file_status s ) noexcept;
+        constexpr bool status_known( file_status s ) noexcept
+        {
+            return s.is( file_type_mask::known );
+        }
 
         file_status symlink_status( path const & p );
         file_status symlink_status( path const & p, std::error_code &ec ) noexcept;
 
+        // fsync(): flushes what the system caches of a file, or of a directory's entries, to the device
+        void sync( path const & p );
+        void sync( path const & p, std::error_code & ec ) noexcept;
+
         //path system_complete( path const & p );
         //path system_complete( path const & p, std::error_code &ec ) noexcept;
 
@@ -299,8 +381,9 @@ namespace tinydircpp {
         path temporary_directory_path( std::error_code & ec ) noexcept;
 
         bool operator==( path const & a, path const & b );
-        //path unique_path( path const & directory_path = path( "%%%%-%%%%-%%%%-%%%%" ) );
-        //path unique_path( path const & p, std::error_code & ec ) noexcept;
+        // model with every '%' replaced by a random hexadecimal digit. Nothing is created, see tempfile.hpp for that.
+        path unique_path( path const & model = path{ L"%%%%-%%%%-%%%%-%%%%" } );
+        path unique_path( path const & model, std::error_code & ec ) noexcept;
     }
 }
 #endif
@@ -1,4 +1,7 @@
 #include "utilities.hpp"
+#include <cwctype>
+#include <random>
+#include <thread>
 
 namespace tinydircpp
 {
@@ -15,12 +18,15 @@ namespace tinydircpp
         {
             if ( this != &p ) {
                 pathname_ = p.pathname_;
+                std::atomic_store( &layout_, std::atomic_load( &p.layout_ ) );
             }
             return *this;
         }
         path & path::operator=( path && p )
         {
             this->pathname_ = std::move( p.pathname_ );
+            std::atomic_store( &layout_, std::atomic_load( &p.layout_ ) );
+            p.layout_.reset();
             return *this;
         }
         path::path( std::wstring const & pathname ) : pathname_{ pathname }
@@ -42,6 +48,7 @@ namespace tinydircpp
         path & path::operator/=( path const & p )
         {
             if ( p.empty() ) return *this;
+            layout_.reset();
             if ( pathname_.empty() && !p.empty() ) {
                 pathname_ = p.native();
                 return *this;
@@ -59,20 +66,211 @@ namespace tinydircpp
             return *this;
         }
 
+        namespace details
+        {
+            bool is_separator( wchar_t c ) noexcept
+            {
+                return c == L'\\' || c == L'/';
+            }
+
+            path child_path( path const & directory, wchar_t const * name, std::size_t name_size )
+            {
+                std::wstring child = directory.native();
+                if ( !child.empty() && !is_separator( child.back() ) ) child.push_back( L'\\' );
+                child.append( name, name_size );
+                return path{ child };
+            }
+
+            std::wstring lower_case( std::wstring name )
+            {
+                for ( auto & c : name ) c = static_cast< wchar_t >( std::towlower( c ) );
+                return name;
+            }
+
+            std::uint64_t thread_random() noexcept
+            {
+                // seeded once per thread; the thread id and the clock keep two threads (or processes) that get the
+                // same seed from a weak random_device apart
+                thread_local std::mt19937_64 generator{ [] {
+                    std::uint64_t seed = static_cast< std::uint64_t >(
+                        std::chrono::high_resolution_clock::now().time_since_epoch().count() );
+                    seed ^= std::hash<std::thread::id>{}( std::this_thread::get_id() ) * 0x9E3779B97F4A7C15ULL;
+                    try {
+                        std::random_device device{};
+                        seed ^= ( std::uint64_t{ device() } << 32 ) | device();
+                    } catch ( std::exception const & ) { // no entropy source, the clock and thread id will do
+                    }
+                    return seed;
+                }() };
+                return generator();
+            }
+
+            std::shared_ptr<path_layout const> make_layout( str_t<wchar_t> const & name )
+            {
+                auto layout = std::make_shared<path_layout>();
+                std::size_t const size = name.size();
+                std::size_t i = 0;
+                if ( size >= 4 && is_separator( name[ 0 ] ) && is_separator( name[ 1 ] )
+                    && ( name[ 2 ] == L'?' || name[ 2 ] == L'.' ) && is_separator( name[ 3 ] ) ) {
+                    i = 4; // "\\?\C:" or "\\?\UNC"
+                    if ( size >= 6 && name[ 5 ] == L':' ) {
+                        i = 6;
+                    } else if ( name.compare( 4, 3, L"UNC" ) == 0 ) {
+                        i = 7;
+                    }
+                } else if ( size >= 2 && is_separator( name[ 0 ] ) && is_separator( name[ 1 ] )
+                    && ( size == 2 || !is_separator( name[ 2 ] ) ) ) {
+                    i = 2; // "\\server"
+                    while ( i < size && !is_separator( name[ i ] ) ) ++i;
+                } else if ( size >= 2 && name[ 1 ] == L':' ) {
+                    i = 2; // "C:"
+                }
+                layout->root_name_size = static_cast< std::uint32_t >( i );
+                if ( i < size && is_separator( name[ i ] ) ) {
+                    layout->root_directory_size = 1;
+                    ++i;
+                }
+                while ( i < size ) {
+                    if ( is_separator( name[ i ] ) ) {
+                        ++i;
+                        continue;
+                    }
+                    std::size_t const first = i;
+                    while ( i < size && !is_separator( name[ i ] ) ) ++i;
+                    layout->names.emplace_back( static_cast< std::uint32_t >( first ),
+                        static_cast< std::uint32_t >( i - first ) );
+                }
+                layout->trailing_separator = !layout->names.empty() && is_separator( name.back() );
+                return layout;
+            }
+        }
+
+        details::path_layout const & path::layout() const
+        {
+            auto layout = std::atomic_load( &layout_ );
+            if ( !layout ) {
+                // two threads may both get here, the first one to publish its layout wins and the other uses it
+                std::shared_ptr<details::path_layout const> published{};
+                layout = details::make_layout( pathname_ );
+                if ( !std::atomic_compare_exchange_strong( &layout_, &published, layout ) ) layout = published;
+            }
+            return *layout;
+        }
+
+        std::size_t path::component_count() const
+        {
+            auto const & parts = layout();
+            return ( parts.root_name_size != 0 ) + ( parts.root_directory_size != 0 ) + parts.names.size();
+        }
+
+        path_component path::component( std::size_t index ) const
+        {
+            auto const & parts = layout();
+            if ( parts.root_name_size != 0 ) {
+                if ( index == 0 ) return path_component{ pathname_.data(), parts.root_name_size };
+                --index;
+            }
+            if ( parts.root_directory_size != 0 ) {
+                if ( index == 0 ) return path_component{ pathname_.data() + parts.root_name_size, 1 };
+                --index;
+            }
+            auto const & name = parts.names[ index ];
+            return path_component{ pathname_.data() + name.first, name.second };
+        }
+
+        path_component path::root_name_component() const
+        {
+            return path_component{ pathname_.data(), layout().root_name_size };
+        }
+
+        path_component path::filename_component() const
+        {
+            auto const & parts = layout();
+            if ( parts.names.empty() || parts.trailing_separator ) return path_component{};
+            return path_component{ pathname_.data() + parts.names.back().first, parts.names.back().second };
+        }
+
+        path_component path::extension_component() const
+        {
+            auto const filename = filename_component();
+            // ".", ".." and two-letter names have no extension
+            if ( filename.size() <= 2 ) return path_component{};
+            for ( std::size_t i = filename.size(); i-- != 0; ) {
+                if ( filename.data()[ i ] == L'.' ) return path_component{ filename.data() + i, filename.size() - i };
+            }
+            return path_component{};
+        }
+
+        path path::root_name() const
+        {
+            return path{ root_name_component().wstring() };
+        }
+
+        path path::root_directory() const
+        {
+            return has_root_directory() ? path{ L"\\" } : path{};
+        }
+
+        path path::relative_path() const
+        {
+            auto const & parts = layout();
+            if ( parts.names.empty() ) return path{};
+            return path{ pathname_.substr( parts.names.front().first ) };
+        }
+
+        path path::parent_path() const
+        {
+            auto const & parts = layout();
+            std::size_t end = parts.root_name_size + parts.root_directory_size;
+            if ( parts.names.size() > 1 ) {
+                auto const & parent = parts.names[ parts.names.size() - 2 ];
+                end = parent.first + parent.second;
+            }
+            return path{ pathname_.substr( 0, end ) };
+        }
+
         path path::extension() const
         {
-            auto const filename = this->filename().string();
-            if ( filename.empty() ) return path{};
-            auto pos = filename.rfind( "." );
-            if ( filename.size() == 1 || filename.size() == 2 || pos == std::string::npos ) return path{};
-            return path{ filename.substr( pos ) };
+            return path{ extension_component().wstring() };
         }
 
         path path::filename() const
         {
-            std::wstring::size_type const loc = pathname_.rfind( WSLASH );
-            if ( loc == 0 || loc == pathname_.size() - 1 ) return{};
-            return path{ pathname_.cbegin() + ( loc == std::wstring::npos ? 0 : loc + 1 ), pathname_.cend() };
+            return path{ filename_component().wstring() };
+        }
+
+        path path::stem() const
+        {
+            auto const filename = filename_component();
+            return path{ std::wstring( filename.data(), filename.size() - extension_component().size() ) };
+        }
+
+        bool path::has_root_name() const
+        {
+            return layout().root_name_size != 0;
+        }
+
+        bool path::has_root_directory() const
+        {
+            return layout().root_directory_size != 0;
+        }
+
+        bool path::has_filename() const
+        {
+            return !filename_component().empty();
+        }
+
+        // "C:\x" and "\\server\x" are absolute, "C:x" and "\x" depend on the current drive or directory
+        bool path::is_absolute() const
+        {
+            auto const & parts = layout();
+            return parts.root_name_size != 0
+                && ( parts.root_directory_size != 0 || details::is_separator( pathname_[ 0 ] ) );
+        }
+
+        bool path::is_relative() const
+        {
+            return !is_absolute();
         }
 
         std::u32string path::u32string() const
@@ -153,20 +351,22 @@ namespace tinydircpp
                 return message;
             }
 
+            // FILETIME counts 100ns ticks since 1601, the system clock counts from 1970. Going through time_t would
+            // throw away everything below a second.
             file_time_type Win32FiletimeToChronoTime( FILETIME const &pFiletime )
             {
                 ULARGE_INTEGER ll_now{};
                 ll_now.LowPart = pFiletime.dwLowDateTime;
                 ll_now.HighPart = pFiletime.dwHighDateTime;
-                std::time_t const epoch_time = ( ll_now.QuadPart / 10000000 ) - 11644473600U;
-                return std::chrono::system_clock::from_time_t( epoch_time );
+                filetime_ticks const since_epoch{ static_cast< std::int64_t >( ll_now.QuadPart ) - unix_epoch_ticks };
+                return file_time_type{ std::chrono::duration_cast< file_time_type::duration >( since_epoch ) };
             }
 
             FILETIME ChronoTimeToWin32Filetime( file_time_type const & ftt )
             {
-                auto const unix_epoch_time = std::chrono::system_clock::to_time_t( ftt );
+                auto const since_epoch = std::chrono::duration_cast< filetime_ticks >( ftt.time_since_epoch() );
                 ULARGE_INTEGER ll_now{};
-                ll_now.QuadPart = 10000000 * ( unix_epoch_time + 11644473600U );
+                ll_now.QuadPart = static_cast< std::uint64_t >( since_epoch.count() + unix_epoch_ticks );
                 return FILETIME{ ll_now.LowPart, ll_now.HighPart };
             }
 
@@ -33,6 +33,11 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <type_traits>
 #include <cstdlib>
 #include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
 
 #ifdef _WIN32
 #include <Windows.h>
@@ -75,6 +80,40 @@ namespace tinydircpp
         template<typename T>
         using str_t = std::basic_string<T, std::char_traits<T>>;
 
+        namespace details {
+            // where the parts of a path begin and end, worked out once per value of the path
+            struct path_layout {
+                std::uint32_t root_name_size = 0;
+                std::uint32_t root_directory_size = 0;
+                bool trailing_separator = false;
+                std::vector<std::pair<std::uint32_t, std::uint32_t>> names{}; // offset and size of each name
+            };
+        }
+
+        // a part of a path, pointing into the path it came from. Valid while that path is alive and unchanged.
+        class path_component {
+        public:
+            path_component() = default;
+            path_component( wchar_t const * data, std::size_t size ) noexcept : data_{ data }, size_{ size } {}
+
+            wchar_t const * data() const noexcept { return data_; }
+            std::size_t size() const noexcept { return size_; }
+            bool empty() const noexcept { return size_ == 0; }
+            std::wstring wstring() const { return std::wstring( data_, size_ ); }
+
+            friend bool operator==( path_component const & a, path_component const & b ) noexcept
+            {
+                return a.size_ == b.size_ && std::char_traits<wchar_t>::compare( a.data_, b.data_, a.size_ ) == 0;
+            }
+            friend bool operator!=( path_component const & a, path_component const & b ) noexcept
+            {
+                return !( a == b );
+            }
+        private:
+            wchar_t const * data_ = L"";
+            std::size_t size_ = 0;
+        };
+
         class path {
         public:
             using value_type = wchar_t;
@@ -83,8 +122,8 @@ namespace tinydircpp
 
             path() = default;
             ~path() = default;
-            path( path && p ) : pathname_{ std::move( p.pathname_ ) } {}
-            path( path const & p ) : pathname_{ p.pathname_ } {}
+            path( path && p ) : pathname_{ std::move( p.pathname_ ) }, layout_{ std::move( p.layout_ ) } {}
+            path( path const & p ) : pathname_{ p.pathname_ }, layout_{ std::atomic_load( &p.layout_ ) } {}
 
             explicit path( std::wstring const & pathname );
             explicit path( std::string const & pathname );
@@ -121,6 +160,7 @@ namespace tinydircpp
             void clear() noexcept
             {
                 pathname_.clear();
+                layout_.reset();
             }
 
             friend path operator/( path const & p, path const & rel_path );
@@ -151,12 +191,27 @@ namespace tinydircpp
             path& replace_extension( path const & );
             int compare( path const & ) const noexcept;
             int compare( std::string const & ) const noexcept;
+            */
             path root_name() const;
             path root_directory() const;
             path relative_path() const;
-            */
+            path parent_path() const;
             path extension() const;
             path filename() const;
+            path stem() const;
+
+            // the same decomposition without building a path for every part. The separators are found the first
+            // time any of these is asked for and remembered until the path changes, copies of the path share them.
+            class const_iterator;
+            using iterator = const_iterator;
+            // root name, root directory, then every name; a trailing separator adds no element
+            const_iterator begin() const;
+            const_iterator end() const;
+            std::size_t component_count() const;
+            path_component component( std::size_t index ) const;
+            path_component root_name_component() const;
+            path_component filename_component() const;
+            path_component extension_component() const;
 
             operator string_type()
             {
@@ -185,16 +240,58 @@ namespace tinydircpp
             {
                 return pathname_;
             }
-            /*
             bool has_root_name() const;
             bool has_root_directory() const;
             bool has_filename() const;
             bool is_absolute() const;
-            bool is_relative() const; */
+            bool is_relative() const;
         private:
+            details::path_layout const & layout() const;
+
             str_t<value_type> pathname_ {}; // basic-string
+            // built lazily by layout(), dropped whenever pathname_ changes
+            mutable std::shared_ptr<details::path_layout const> layout_ {};
+        };
+
+        class path::const_iterator {
+        public:
+            using iterator_category = std::input_iterator_tag; // elements are made on the fly
+            using value_type = path_component;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            using reference = path_component;
+
+            const_iterator() = default;
+            const_iterator( path const * p, std::size_t index ) noexcept : path_{ p }, index_{ index } {}
+
+            path_component operator*() const { return path_->component( index_ ); }
+            const_iterator& operator++() noexcept { ++index_; return *this; }
+            const_iterator operator++( int ) noexcept { auto copy = *this; ++index_; return copy; }
+            const_iterator& operator--() noexcept { --index_; return *this; }
+            const_iterator operator--( int ) noexcept { auto copy = *this; --index_; return copy; }
+            friend bool operator==( const_iterator const & a, const_iterator const & b ) noexcept
+            {
+                return a.path_ == b.path_ && a.index_ == b.index_;
+            }
+            friend bool operator!=( const_iterator const & a, const_iterator const & b ) noexcept
+            {
+                return !( a == b );
+            }
+        private:
+            path const * path_ = nullptr;
+            std::size_t index_ = 0;
         };
 
+        inline path::const_iterator path::begin() const
+        {
+            return const_iterator{ this, 0 };
+        }
+
+        inline path::const_iterator path::end() const
+        {
+            return const_iterator{ this, component_count() };
+        }
+
         enum class filesystem_error_codes
         {
             directory_name_unobtainable = 0x80,
@@ -239,8 +336,25 @@ namespace tinydircpp
                 HANDLE h_;
             };
 
-            std::string get_windows_error( DWORD error_code );
+            // for what the system hands out with LocalAlloc: SIDs, security descriptors and their strings
+            struct local_deleter {
+                void operator()( void * p ) const noexcept { LocalFree( p ); }
+            };
+            using local_pointer = std::unique_ptr<void, local_deleter>;
 
+            std::string get_windows_error( DWORD error_code );
+            bool is_separator( wchar_t c ) noexcept;
+            // names compare case-insensitively on Windows, lower-cased names can be compared as they are
+            std::wstring lower_case( std::wstring name );
+            // directory\name without going through operator/, which drops a name's leading dots when directory
+            // ends with a separator
+            path child_path( path const & directory, wchar_t const * name, std::size_t name_size );
+            // 64 random bits from a generator of the calling thread's own, threads never wait on each other for them
+            std::uint64_t thread_random() noexcept;
+
+            // the unit of a FILETIME, and where 1970-01-01 falls in them
+            using filetime_ticks = std::chrono::duration<std::int64_t, std::ratio<1, 10000000>>;
+            constexpr std::int64_t unix_epoch_ticks = 116444736000000000LL;
             file_time_type Win32FiletimeToChronoTime( FILETIME const &pFiletime );
             FILETIME ChronoTimeToWin32Filetime( file_time_type const & ftt );
 
@@ -302,6 +416,38 @@ namespace tinydircpp
             unknown
         };
 
+        // one bit per file_type, so that a type is tested against any set of types with a single AND
+        enum class file_type_mask : unsigned {
+            not_found = 1u << 0,
+            none = 1u << 1,
+            regular = 1u << 2,
+            directory = 1u << 3,
+            symlink = 1u << 4,
+            block = 1u << 5,
+            character = 1u << 6,
+            fifo = 1u << 7,
+            socket = 1u << 8,
+            unknown = 1u << 9,
+            other = block | character | fifo | socket | unknown,
+            exists = regular | directory | symlink | other,
+            known = not_found | exists
+        };
+
+        constexpr file_type_mask operator|( file_type_mask a, file_type_mask b ) noexcept
+        {
+            return static_cast< file_type_mask >( static_cast< unsigned >( a ) | static_cast< unsigned >( b ) );
+        }
+
+        constexpr file_type_mask operator&( file_type_mask a, file_type_mask b ) noexcept
+        {
+            return static_cast< file_type_mask >( static_cast< unsigned >( a ) & static_cast< unsigned >( b ) );
+        }
+
+        constexpr file_type_mask type_mask( file_type t ) noexcept
+        {
+            return static_cast< file_type_mask >( 1u << ( static_cast< int >( t ) + 1 ) );
+        }
+
         enum class copy_options : int {
             none = 0,
             skip_existing = 0x1,
@@ -336,6 +482,50 @@ namespace tinydircpp
             unknown = 0xFFFF,
             symlink_perms = 0x4000
         };
+
+        constexpr perms operator|( perms a, perms b ) noexcept
+        {
+            return static_cast< perms >( static_cast< int >( a ) | static_cast< int >( b ) );
+        }
+
+        constexpr perms operator&( perms a, perms b ) noexcept
+        {
+            return static_cast< perms >( static_cast< int >( a ) & static_cast< int >( b ) );
+        }
+
+        constexpr perms operator~( perms a ) noexcept
+        {
+            return static_cast< perms >( ~static_cast< int >( a ) & static_cast< int >( perms::unknown ) );
+        }
+
+        namespace details
+        {
+            // the file type bits of a POSIX st_mode shifted down, S_IFMT >> 12. A dirent's d_type holds the very
+            // same values (DT_FIFO is S_IFIFO >> 12 and so on), so this one table decodes both; 0 is DT_UNKNOWN.
+            constexpr file_type posix_types[ 16 ] = {
+                file_type::none, file_type::fifo, file_type::character, file_type::unknown,
+                file_type::directory, file_type::unknown, file_type::block, file_type::unknown,
+                file_type::regular, file_type::unknown, file_type::symlink, file_type::unknown,
+                file_type::socket, file_type::unknown, file_type::unknown, file_type::unknown
+            };
+        }
+
+        // for listings and archives that come from POSIX systems
+        constexpr file_type type_from_mode( unsigned mode ) noexcept
+        {
+            return details::posix_types[ ( mode >> 12 ) & 0xF ];
+        }
+
+        constexpr file_type type_from_dirent_type( unsigned char d_type ) noexcept
+        {
+            return details::posix_types[ d_type & 0xF ];
+        }
+
+        // the permission bits of perms are those of st_mode
+        constexpr perms perms_from_mode( unsigned mode ) noexcept
+        {
+            return static_cast< perms >( mode & 07777 );
+        }
         //supposed to be in <ntifs.h> but weirdly this header isn't available to use but MSDN shows what it looks like
         struct REPARSE_DATA_BUFFER
         {
@@ -0,0 +1,164 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "volume.hpp"
+#include "instrumentation.hpp"
+#include <mutex>
+#include <unordered_map>
+
+// Windows 10 SDK and later, the 8.1 one doesn't know about block cloning (ReFS)
+#ifndef FILE_SUPPORTS_BLOCK_REFCOUNTING
+#define FILE_SUPPORTS_BLOCK_REFCOUNTING 0x08000000
+#endif
+
+namespace tinydircpp {
+    namespace fs {
+        namespace details
+        {
+            struct volume_cache {
+                std::mutex mutex{};
+                // by the case-folded root
+                std::unordered_map<std::wstring, volume_capabilities> volumes{};
+            };
+
+            volume_cache & volumes()
+            {
+                static volume_cache cache{};
+                return cache;
+            }
+
+            volume_kind kind_from_drive_type( UINT drive_type ) noexcept
+            {
+                switch ( drive_type ) {
+                case DRIVE_REMOVABLE: return volume_kind::removable;
+                case DRIVE_FIXED: return volume_kind::fixed;
+                case DRIVE_REMOTE: return volume_kind::remote;
+                case DRIVE_CDROM: return volume_kind::optical;
+                case DRIVE_RAMDISK: return volume_kind::ram_disk;
+                default: return volume_kind::unknown;
+                }
+            }
+
+            volume_capabilities probe_volume( path const & root )
+            {
+                volume_capabilities volume{};
+                DWORD serial_number = 0, max_name_length = 0, flags = 0;
+                wchar_t file_system[ MAX_PATH + 1 ]{};
+                if ( TINYDIR_SYSCALL( volume_information, GetVolumeInformationW( root.c_str(), nullptr, 0,
+                    &serial_number, &max_name_length, &flags, file_system, MAX_PATH + 1 ) ) == 0 ) {
+                    FSTHROW_MANUAL( fs::filesystem_error_codes::unknown_io_error, root );
+                }
+                volume.root = root;
+                volume.file_system = file_system;
+                volume.serial_number = serial_number;
+                volume.max_name_length = max_name_length;
+                UINT const drive_type = TINYDIR_SYSCALL( volume_information, GetDriveTypeW( root.c_str() ) );
+                volume.kind = kind_from_drive_type( drive_type );
+                volume.read_only = ( flags & FILE_READ_ONLY_VOLUME ) != 0;
+                volume.case_sensitive = ( flags & FILE_CASE_SENSITIVE_SEARCH ) != 0;
+                volume.hard_links = ( flags & FILE_SUPPORTS_HARD_LINKS ) != 0;
+                volume.reparse_points = ( flags & FILE_SUPPORTS_REPARSE_POINTS ) != 0;
+                volume.named_streams = ( flags & FILE_NAMED_STREAMS ) != 0;
+                volume.sparse_files = ( flags & FILE_SUPPORTS_SPARSE_FILES ) != 0;
+                volume.block_cloning = ( flags & FILE_SUPPORTS_BLOCK_REFCOUNTING ) != 0;
+                volume.persistent_acls = ( flags & FILE_PERSISTENT_ACLS ) != 0;
+                volume.open_by_file_id = ( flags & FILE_SUPPORTS_OPEN_BY_FILE_ID ) != 0;
+                volume.compression = ( flags & FILE_FILE_COMPRESSION ) != 0;
+                return volume;
+            }
+
+            // compares the way Windows does: case aside, and "C:\\mnt" is "C:\\mnt\\"
+            std::wstring volume_key( std::wstring name )
+            {
+                if ( !name.empty() && !is_separator( name.back() ) ) name.push_back( L'\\' );
+                return lower_case( std::move( name ) );
+            }
+        }
+
+        path volume_root( path const & p )
+        {
+            path const full_path = abspath( p );
+            // the root is a prefix of the full path, give or take a trailing separator
+            std::wstring root( full_path.native().size() + 2, L'\0' );
+            if ( TINYDIR_SYSCALL( volume_information, GetVolumePathNameW( full_path.c_str(), &root[ 0 ],
+                static_cast< DWORD >( root.size() ) ) ) == 0 ) {
+                FSTHROW_MANUAL( fs::filesystem_error_codes::unknown_io_error, p );
+            }
+            root.resize( root.find( L'\0' ) );
+            return path{ root };
+        }
+
+        path volume_root( path const & p, std::error_code & ec ) noexcept
+        {
+            FSERROR_TRY_CATCH( return volume_root( p ), ec );
+            return path{};
+        }
+
+        volume_capabilities volume_of( path const & p )
+        {
+            TINYDIR_TRACE_API( volume );
+            path const root = volume_root( p );
+            std::wstring const key = details::volume_key( root.native() );
+            auto & cache = details::volumes();
+            {
+                std::lock_guard<std::mutex> lock{ cache.mutex };
+                auto const found = cache.volumes.find( key );
+                if ( found != cache.volumes.end() ) return found->second;
+            }
+            // probed outside the lock, a slow network share doesn't hold up lookups of other volumes. Two threads
+            // may both probe a new volume, they come up with the same answer.
+            volume_capabilities volume = details::probe_volume( root );
+            std::lock_guard<std::mutex> lock{ cache.mutex };
+            return cache.volumes.emplace( key, std::move( volume ) ).first->second;
+        }
+
+        volume_capabilities volume_of( path const & p, std::error_code & ec ) noexcept
+        {
+            FSERROR_TRY_CATCH( return volume_of( p ), ec );
+            return volume_capabilities{};
+        }
+
+        void forget_volumes() noexcept
+        {
+            auto & cache = details::volumes();
+            std::lock_guard<std::mutex> lock{ cache.mutex };
+            cache.volumes.clear();
+        }
+
+        bool is_mount( path const & p )
+        {
+            TINYDIR_TRACE_API( volume );
+            return details::volume_key( volume_root( p ).native() ) == details::volume_key( abspath( p ).native() );
+        }
+
+        bool is_mount( path const & p, std::error_code & ec ) noexcept
+        {
+            FSERROR_TRY_CATCH( return is_mount( p ), ec );
+            return false;
+        }
+    }
+}
+
+#undef FSERROR_TRY_CATCH
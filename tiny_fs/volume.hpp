@@ -0,0 +1,82 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef TINYDIRCPP_VOLUME_HPP
+#define TINYDIRCPP_VOLUME_HPP
+
+#include <cstdint>
+#include <string>
+
+#include "tinydircpp.hpp"
+
+namespace tinydircpp {
+    namespace fs
+    {
+        enum class volume_kind {
+            unknown,
+            removable,
+            fixed,
+            remote,
+            optical,
+            ram_disk
+        };
+
+        // what the file system behind a volume can do, so that callers can choose a strategy up front instead of
+        // trying it on every file and falling back when the call fails
+        struct volume_capabilities {
+            path root{};                   // where the volume is mounted: "C:\\", "\\\\server\\share\\" or a folder
+            std::wstring file_system{};    // "NTFS", "ReFS", "FAT32", ...
+            std::uint32_t serial_number = 0;
+            std::uint32_t max_name_length = 0; // of a single path component
+            volume_kind kind = volume_kind::unknown;
+            bool read_only = false;
+            bool case_sensitive = false;
+            bool hard_links = false;
+            bool reparse_points = false;   // symbolic links and junctions
+            bool named_streams = false;    // see xattr.hpp
+            bool sparse_files = false;
+            bool block_cloning = false;    // copy by sharing clusters, as on ReFS
+            bool persistent_acls = false;
+            bool open_by_file_id = false;
+            bool compression = false;
+        };
+
+        // the root of the volume p is on, p need not exist
+        path volume_root( path const & p );
+        path volume_root( path const & p, std::error_code & ec ) noexcept;
+
+        // the capabilities of the volume p is on. A volume is probed the first time it is asked about and served
+        // from a process wide cache after that, finding its root is all the other calls cost.
+        volume_capabilities volume_of( path const & p );
+        volume_capabilities volume_of( path const & p, std::error_code & ec ) noexcept;
+        // empties the cache, for when volumes may have been reformatted or remounted
+        void forget_volumes() noexcept;
+
+        // true when p is the root of a volume: a drive, a share or a folder another volume is mounted on
+        bool is_mount( path const & p );
+        bool is_mount( path const & p, std::error_code & ec ) noexcept;
+    }
+}
+#endif
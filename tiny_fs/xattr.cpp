@@ -0,0 +1,237 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "xattr.hpp"
+#include "arena.hpp"
+#include "instrumentation.hpp"
+#include "volume.hpp"
+#include <algorithm>
+#include <cwchar>
+
+#ifdef _WIN32
+#include <AclAPI.h>
+#include <sddl.h>
+#endif // _WIN32
+
+namespace tinydircpp {
+    namespace fs {
+        namespace details
+        {
+            // a named data stream is listed as ":name:$DATA", the file's own contents as "::$DATA"
+            bool is_named_data_stream( wchar_t const * name, std::size_t name_size ) noexcept
+            {
+                wchar_t const suffix[] = L":$DATA";
+                std::size_t const suffix_size = sizeof( suffix ) / sizeof( wchar_t ) - 1;
+                return name_size > suffix_size + 1 && name[ 0 ] == L':'
+                    && std::char_traits<wchar_t>::compare( name + name_size - suffix_size, suffix, suffix_size ) == 0;
+            }
+
+            void read_stream( std::wstring const & stream_path, path const & p, std::uint64_t size,
+                std::string & value )
+            {
+                smart_handle stream{ TINYDIR_SYSCALL( create_file, CreateFileW( stream_path.c_str(), GENERIC_READ,
+                    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                    FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_SEQUENTIAL_SCAN, nullptr ) ) };
+                if ( !stream ) {
+                    FSTHROW_MANUAL( fs::filesystem_error_codes::handle_not_opened, p );
+                }
+                value.resize( static_cast< std::size_t >( size ) );
+                std::size_t done = 0;
+                while ( done != value.size() ) {
+                    DWORD const chunk = static_cast< DWORD >( ( std::min )( value.size() - done,
+                        std::size_t{ 64 * 1024 * 1024 } ) );
+                    DWORD read = 0;
+                    if ( TINYDIR_SYSCALL( read_file, ReadFile( stream, &value[ done ], chunk, &read,
+                        nullptr ) ) == 0 ) {
+                        FSTHROW_MANUAL( fs::filesystem_error_codes::unknown_io_error, p );
+                    }
+                    if ( read == 0 ) break; // shrunk since it was listed
+                    done += read;
+                }
+                value.resize( done );
+            }
+        }
+
+        void xattr_reader::read( path const & p, xattr_list & attributes )
+        {
+            TINYDIR_TRACE_API( xattrs );
+            DWORD const access = FILE_READ_ATTRIBUTES | ( with_security_descriptor_ ? READ_CONTROL : 0 );
+            details::smart_handle file{ TINYDIR_SYSCALL( create_file, CreateFileW( p.c_str(), access,
+                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OPEN_REPARSE_POINT, nullptr ) ) };
+            if ( !file ) {
+                FSTHROW_MANUAL( fs::filesystem_error_codes::handle_not_opened, p );
+            }
+
+            // the buffer only ever grows, after a few entries it is large enough to list any of them in one go
+            if ( stream_information_.empty() ) stream_information_.resize( 4096 );
+            bool has_streams = list_streams_;
+            while ( has_streams && TINYDIR_SYSCALL( get_file_information, GetFileInformationByHandleEx( file,
+                FileStreamInfo, stream_information_.data(), static_cast< DWORD >( stream_information_.size() ) ) )
+                == 0 ) {
+                DWORD const error = GetLastError();
+                if ( error == ERROR_HANDLE_EOF ) { // no data stream at all, as with most directories
+                    has_streams = false;
+                    break;
+                }
+                if ( error != ERROR_MORE_DATA ) {
+                    FSTHROW_MANUAL( fs::filesystem_error_codes::unknown_io_error, p );
+                }
+                stream_information_.resize( stream_information_.size() * 2 );
+            }
+
+            std::size_t count = 0;
+            char const * record = stream_information_.data();
+            while ( has_streams ) {
+                auto const & information = *reinterpret_cast< FILE_STREAM_INFO const * >( record );
+                std::size_t const name_size = information.StreamNameLength / sizeof( wchar_t );
+                if ( details::is_named_data_stream( information.StreamName, name_size ) ) {
+                    if ( attributes.size() == count ) attributes.emplace_back();
+                    xattr & attribute = attributes[ count++ ];
+                    attribute.name.assign( information.StreamName + 1, name_size - 7 );
+                    stream_path_.assign( p.native() ).append( information.StreamName, name_size );
+                    details::read_stream( stream_path_, p, information.StreamSize.QuadPart, attribute.value );
+                    TINYDIR_COUNT_BYTES( xattrs, attribute.value.size() );
+                }
+                if ( information.NextEntryOffset == 0 ) break;
+                record += information.NextEntryOffset;
+            }
+            attributes.resize( count );
+
+            security_descriptor_.clear();
+            if ( !with_security_descriptor_ ) return;
+            SECURITY_INFORMATION const parts = OWNER_SECURITY_INFORMATION | GROUP_SECURITY_INFORMATION
+                | DACL_SECURITY_INFORMATION;
+            PSECURITY_DESCRIPTOR descriptor = nullptr;
+            DWORD const result = TINYDIR_SYSCALL( security_info, GetSecurityInfo( file, SE_FILE_OBJECT, parts,
+                nullptr, nullptr, nullptr, nullptr, &descriptor ) );
+            if ( result != ERROR_SUCCESS ) {
+                SetLastError( result );
+                FSTHROW_MANUAL( fs::filesystem_error_codes::unknown_io_error, p );
+            }
+            details::local_pointer const descriptor_guard{ descriptor };
+            wchar_t * text = nullptr;
+            if ( ConvertSecurityDescriptorToStringSecurityDescriptorW( descriptor, SDDL_REVISION_1, parts, &text,
+                nullptr ) == 0 ) {
+                FSTHROW_MANUAL( fs::filesystem_error_codes::unknown_io_error, p );
+            }
+            details::local_pointer const text_guard{ text };
+            security_descriptor_.assign( text );
+        }
+
+        xattr_list get_xattrs( path const & p )
+        {
+            xattr_reader reader{};
+            xattr_list attributes{};
+            reader.read( p, attributes );
+            return attributes;
+        }
+
+        xattr_list get_xattrs( path const & p, std::error_code & ec ) noexcept
+        {
+            FSERROR_TRY_CATCH( return get_xattrs( p ), ec );
+            return {};
+        }
+
+        void set_xattrs( path const & p, xattr_list const & attributes )
+        {
+            TINYDIR_TRACE_API( xattrs );
+            std::wstring stream_path{};
+            for ( auto const & attribute : attributes ) {
+                if ( attribute.name.empty() || attribute.name.find_first_of( L":\\/" ) != std::wstring::npos ) {
+                    throw fs::filesystem_error{ "invalid attribute name", p,
+                        std::make_error_code( std::errc::invalid_argument ) };
+                }
+                stream_path.assign( p.native() ).append( 1, L':' ).append( attribute.name );
+                details::smart_handle stream{ TINYDIR_SYSCALL( create_file, CreateFileW( stream_path.c_str(),
+                    GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_FLAG_BACKUP_SEMANTICS, nullptr ) ) };
+                if ( !stream ) {
+                    FSTHROW_MANUAL( fs::filesystem_error_codes::handle_not_opened, p );
+                }
+                std::size_t done = 0;
+                while ( done != attribute.value.size() ) {
+                    DWORD const chunk = static_cast< DWORD >( ( std::min )( attribute.value.size() - done,
+                        std::size_t{ 64 * 1024 * 1024 } ) );
+                    DWORD written = 0;
+                    if ( TINYDIR_SYSCALL( write_file, WriteFile( stream, attribute.value.data() + done, chunk,
+                        &written, nullptr ) ) == 0 ) {
+                        FSTHROW_MANUAL( fs::filesystem_error_codes::unknown_io_error, p );
+                    }
+                    done += written;
+                }
+                TINYDIR_COUNT_BYTES( xattrs, done );
+            }
+        }
+
+        void set_xattrs( path const & p, xattr_list const & attributes, std::error_code & ec ) noexcept
+        {
+            FSERROR_TRY_CATCH( set_xattrs( p, attributes ), ec );
+        }
+
+        std::uintmax_t walk_xattrs( path const & root, xattr_visitor const & visitor, bool with_security_descriptor )
+        {
+            struct context_type {
+                xattr_visitor const & visitor;
+                xattr_reader reader;
+                xattr_list attributes;
+                std::vector<path> pending;
+                path const * directory;
+                std::uintmax_t visited;
+            } context{ visitor, xattr_reader{ with_security_descriptor, volume_of( root ).named_streams }, {}, {},
+                nullptr, 1 };
+
+            context.reader.read( root, context.attributes );
+            visitor( root, context.attributes, context.reader.security_descriptor() );
+            if ( is_directory( status( root ) ) ) context.pending.push_back( root );
+            while ( !context.pending.empty() ) {
+                path const directory = std::move( context.pending.back() );
+                context.pending.pop_back();
+                context.directory = &directory;
+                details::visit_directory( directory, []( void * c, WIN32_FIND_DATAW const & data ) {
+                    auto & ctx = *static_cast< context_type * >( c );
+                    path child_path = details::child_path( *ctx.directory, data.cFileName,
+                        std::wcslen( data.cFileName ) );
+                    ctx.reader.read( child_path, ctx.attributes );
+                    ctx.visitor( child_path, ctx.attributes, ctx.reader.security_descriptor() );
+                    ++ctx.visited;
+                    if ( details::status_from_attributes( data.dwFileAttributes, data.dwReserved0 ).type()
+                        == file_type::directory ) {
+                        ctx.pending.push_back( std::move( child_path ) );
+                    }
+                }, &context );
+            }
+            return context.visited;
+        }
+
+        std::uintmax_t walk_xattrs( path const & root, xattr_visitor const & visitor, bool with_security_descriptor,
+            std::error_code & ec ) noexcept
+        {
+            FSERROR_TRY_CATCH( return walk_xattrs( root, visitor, with_security_descriptor ), ec );
+            return 0;
+        }
+    }
+}
+
+#undef FSERROR_TRY_CATCH
@@ -0,0 +1,88 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef TINYDIRCPP_XATTR_HPP
+#define TINYDIRCPP_XATTR_HPP
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "tinydircpp.hpp"
+
+namespace tinydircpp {
+    namespace fs
+    {
+        // NTFS keeps what other systems call extended attributes as named alternate data streams: name is the
+        // stream's ("tags" for the stream file.txt:tags), value its contents
+        struct xattr {
+            std::wstring name;
+            std::string value;
+        };
+        using xattr_list = std::vector<xattr>;
+
+        // reads the attributes, and optionally the security descriptor, of one entry after another with the same
+        // buffers. The streams of an entry are all listed by a single query on one open handle, which also serves
+        // the security descriptor; then each stream is read with one request of exactly its size.
+        class xattr_reader {
+        public:
+            // without list_streams no attributes are looked for, for volumes that have no named streams to list
+            // (see volume_capabilities) and would fail the query on every entry
+            explicit xattr_reader( bool with_security_descriptor = false, bool list_streams = true ) noexcept :
+                with_security_descriptor_{ with_security_descriptor }, list_streams_{ list_streams }
+            {
+            }
+
+            // attributes is overwritten, the strings of its elements keep their capacity for the next entry
+            void read( path const & p, xattr_list & attributes );
+            // the owner, group and DACL in SDDL, empty unless the reader was made with_security_descriptor
+            std::wstring const & security_descriptor() const noexcept { return security_descriptor_; }
+        private:
+            bool with_security_descriptor_;
+            bool list_streams_;
+            std::vector<char> stream_information_{};
+            std::wstring stream_path_{};
+            std::wstring security_descriptor_{};
+        };
+
+        xattr_list get_xattrs( path const & p );
+        xattr_list get_xattrs( path const & p, std::error_code & ec ) noexcept;
+        // creates or replaces the named attributes, leaving any others p has alone
+        void set_xattrs( path const & p, xattr_list const & attributes );
+        void set_xattrs( path const & p, xattr_list const & attributes, std::error_code & ec ) noexcept;
+
+        using xattr_visitor = std::function<void( path const & p, xattr_list const & attributes,
+            std::wstring const & security_descriptor )>;
+        // visits root and everything below it with its attributes (and security descriptor, if asked for), all read
+        // through one xattr_reader. Streams are only listed when root's volume has them. Returns the number of
+        // entries visited.
+        std::uintmax_t walk_xattrs( path const & root, xattr_visitor const & visitor,
+            bool with_security_descriptor = false );
+        std::uintmax_t walk_xattrs( path const & root, xattr_visitor const & visitor, bool with_security_descriptor,
+            std::error_code & ec ) noexcept;
+    }
+}
+#endif
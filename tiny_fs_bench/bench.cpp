@@ -0,0 +1,255 @@
+/*
+Copyright (c) 2019 - Joshua Ogunyinka
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// bench.cpp : builds synthetic trees under the temporary directory and times the library's hot paths on them.
+// usage: tiny_fs_bench [results-file] [scale]
+// every measurement is appended to the results file as one JSON object per line, so runs from different
+// releases can simply be concatenated and compared.
+
+#include "..\tiny_fs\tinydircpp.hpp"
+#include "..\tiny_fs\scandir.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace fs = tinydircpp::fs;
+
+namespace
+{
+    struct bench_result {
+        std::string benchmark;
+        std::string tree;
+        std::size_t operations;
+        double seconds;
+    };
+
+    class stopwatch {
+    public:
+        stopwatch() : start_{ std::chrono::steady_clock::now() } {}
+        double seconds() const
+        {
+            return std::chrono::duration<double>( std::chrono::steady_clock::now() - start_ ).count();
+        }
+    private:
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    struct synthetic_tree {
+        std::string name;
+        fs::path root;
+        std::vector<fs::path> directories; // deepest last
+        std::vector<fs::path> files;
+    };
+
+    void write_file( fs::path const & p, std::size_t size )
+    {
+        fs::details::smart_handle h{ CreateFileW( p.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+            FILE_ATTRIBUTE_NORMAL, nullptr ) };
+        if ( !h ) throw std::runtime_error( "unable to create " + p.string() );
+        std::string const data( size, 'x' );
+        DWORD written = 0;
+        if ( size != 0 && WriteFile( h, data.data(), static_cast< DWORD >( size ), &written, nullptr ) == 0 ) {
+            throw std::runtime_error( "unable to write " + p.string() );
+        }
+    }
+
+    // `width` files in each of `dirs_per_level` directories on every one of `depth` levels
+    synthetic_tree make_tree( fs::path const & base, std::string const & name, std::size_t depth,
+        std::size_t dirs_per_level, std::size_t width, std::size_t name_length, std::size_t file_size )
+    {
+        synthetic_tree tree{ name, base / fs::path{ name }, {}, {} };
+        fs::create_directories( tree.root );
+        std::vector<fs::path> level{ tree.root };
+        for ( std::size_t d = 0; d != depth; ++d ) {
+            std::vector<fs::path> next_level{};
+            for ( auto const & parent : level ) {
+                for ( std::size_t f = 0; f != width; ++f ) {
+                    std::string file_name = "f" + std::to_string( f );
+                    file_name.resize( std::max( name_length, file_name.size() ), 'n' );
+                    tree.files.push_back( parent / fs::path{ file_name + ".dat" } );
+                    write_file( tree.files.back(), file_size );
+                }
+                for ( std::size_t sub = 0; sub != dirs_per_level; ++sub ) {
+                    next_level.push_back( parent / fs::path{ "d" + std::to_string( sub ) } );
+                    fs::create_directories( next_level.back() );
+                    tree.directories.push_back( next_level.back() );
+                }
+            }
+            level.swap( next_level );
+        }
+        return tree;
+    }
+
+    std::size_t walk( fs::path const & p, std::size_t prefetch )
+    {
+        std::size_t count = 0;
+        for ( fs::directory_iterator iter{ p, prefetch }, end{}; iter != end; ++iter ) {
+            ++count;
+            if ( fs::is_directory( ( *iter ).status() ) ) count += walk( ( *iter ).path(), prefetch );
+        }
+        return count;
+    }
+
+    std::size_t walk_scandir( fs::path const & p )
+    {
+        std::size_t count = 0;
+        for ( auto const & entry : fs::scandir( p, fs::scandir_filter{}, fs::scandir_sort::none ) ) {
+            ++count;
+            if ( entry.is_dir() ) count += walk_scandir( entry.path() );
+        }
+        return count;
+    }
+
+    void remove_tree( synthetic_tree const & tree, std::vector<bench_result> & results )
+    {
+        stopwatch const timer{};
+        for ( auto const & file : tree.files ) DeleteFileW( file.c_str() );
+        for ( auto iter = tree.directories.rbegin(); iter != tree.directories.rend(); ++iter ) {
+            RemoveDirectoryW( iter->c_str() );
+        }
+        RemoveDirectoryW( tree.root.c_str() );
+        results.push_back( { "remove", tree.name, tree.files.size() + tree.directories.size() + 1,
+            timer.seconds() } );
+    }
+
+    void run_tree_benchmarks( synthetic_tree const & tree, std::vector<bench_result> & results )
+    {
+        std::size_t entries = 0;
+        {
+            stopwatch const timer{};
+            entries = walk( tree.root, 0 );
+            results.push_back( { "directory_iterator", tree.name, entries, timer.seconds() } );
+        }
+        {
+            stopwatch const timer{};
+            entries = walk( tree.root, 256 );
+            results.push_back( { "directory_iterator_prefetch", tree.name, entries, timer.seconds() } );
+        }
+        {
+            stopwatch const timer{};
+            entries = walk_scandir( tree.root );
+            results.push_back( { "scandir", tree.name, entries, timer.seconds() } );
+        }
+        {
+            stopwatch const timer{};
+            for ( auto const & file : tree.files ) fs::status( file );
+            results.push_back( { "status", tree.name, tree.files.size(), timer.seconds() } );
+        }
+        {
+            stopwatch const timer{};
+            for ( auto const & file : tree.files ) fs::file_size( file );
+            results.push_back( { "file_size", tree.name, tree.files.size(), timer.seconds() } );
+        }
+        {
+            // split outside the timer, only the join itself is measured
+            std::vector<fs::path> parents{}, names{};
+            parents.reserve( tree.files.size() );
+            names.reserve( tree.files.size() );
+            for ( auto const & file : tree.files ) {
+                parents.push_back( fs::directory_name( file ) );
+                names.push_back( fs::basename( file ) );
+            }
+            stopwatch const timer{};
+            std::size_t total = 0;
+            for ( std::size_t i = 0; i != parents.size(); ++i ) total += ( parents[ i ] / names[ i ] ).native().size();
+            results.push_back( { "operator/", tree.name, tree.files.size(), timer.seconds() } );
+            if ( total == 0 ) std::cerr << "operator/ produced no output\n";
+        }
+        {
+            stopwatch const timer{};
+            std::size_t total = 0;
+            for ( auto const & file : tree.files ) total += file.string().size();
+            results.push_back( { "convert_to", tree.name, tree.files.size(), timer.seconds() } );
+            if ( total == 0 ) std::cerr << "convert_to produced no output\n";
+        }
+        {
+            stopwatch const timer{};
+            auto const prefix = fs::common_prefix( tree.files.begin(), tree.files.end() );
+            results.push_back( { "common_prefix", tree.name, tree.files.size(), timer.seconds() } );
+            if ( prefix.empty() ) std::cerr << "common_prefix of " << tree.name << " is empty\n";
+        }
+        {
+            fs::path const copies{ tree.root / fs::path{ "copies" } };
+            fs::create_directories( copies );
+            // fs::copy won't overwrite, whatever a crashed run left behind goes first
+            for ( fs::directory_iterator iter{ copies }, end{}; iter != end; ++iter ) {
+                DeleteFileW( ( *iter ).path().c_str() );
+            }
+            synthetic_tree copied{ tree.name + "_copies", copies, {}, {} };
+            stopwatch const timer{};
+            for ( std::size_t i = 0; i != tree.files.size(); ++i ) {
+                copied.files.push_back( copies / fs::path{ "c" + std::to_string( i ) } );
+                fs::copy( tree.files[ i ], copied.files.back() );
+            }
+            results.push_back( { "copy", tree.name, tree.files.size(), timer.seconds() } );
+            remove_tree( copied, results );
+        }
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    std::string const results_file = argc > 1 ? argv[ 1 ] : "bench_results.json";
+    std::size_t const scale = argc > 2 ? std::max( 1, std::atoi( argv[ 2 ] ) ) : 1;
+    try {
+        fs::path const base = fs::temporary_directory_path() / fs::path{ "tiny_fs_bench" };
+        fs::create_directories( base );
+
+        std::vector<bench_result> results{};
+        std::vector<synthetic_tree> const trees{
+            make_tree( base, "wide", 1, 0, 20000 * scale, 0, 0 ),
+            make_tree( base, "deep", 64, 1, 4 * scale, 0, 0 ), // depth stays within MAX_PATH
+            make_tree( base, "small_files", 4, 4, 40 * scale, 0, 512 ),
+            make_tree( base, "long_names", 1, 0, 2000 * scale, 200, 0 )
+        };
+        for ( auto const & tree : trees ) {
+            run_tree_benchmarks( tree, results );
+            remove_tree( tree, results );
+        }
+        RemoveDirectoryW( base.c_str() );
+
+        std::ofstream out{ results_file, std::ios::app };
+        for ( auto const & r : results ) {
+            double const ops_per_second = r.seconds > 0 ? r.operations / r.seconds : 0.0;
+            double const ns_per_op = r.operations != 0 ? ( r.seconds * 1e9 ) / r.operations : 0.0;
+            out << "{\"benchmark\":\"" << r.benchmark << "\",\"tree\":\"" << r.tree << "\",\"scale\":" << scale
+                << ",\"operations\":" << r.operations << ",\"seconds\":" << r.seconds
+                << ",\"ops_per_second\":" << ops_per_second << ",\"ns_per_op\":" << ns_per_op << "}\n";
+            std::cout << r.tree << "\t" << r.benchmark << "\t" << r.operations << " ops\t" << ns_per_op
+                << " ns/op\n";
+        }
+    } catch ( fs::filesystem_error const & e ) {
+        std::cerr << e.what() << ": " << e.path1().string() << "\n";
+        return EXIT_FAILURE;
+    } catch ( std::exception const & e ) {
+        std::cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
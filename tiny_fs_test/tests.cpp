@@ -27,6 +27,26 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "external\catch.hpp"
 #include "..\tiny_fs\tinydircpp.hpp"
+#include "..\tiny_fs\scandir.hpp"
+#include "..\tiny_fs\instrumentation.hpp"
+#include "..\tiny_fs\status_cache.hpp"
+#include "..\tiny_fs\async.hpp"
+#include "..\tiny_fs\create_directories.hpp"
+#include "..\tiny_fs\arena.hpp"
+#include "..\tiny_fs\canonical.hpp"
+#include "..\tiny_fs\sync_tree.hpp"
+#include "..\tiny_fs\listing_writer.hpp"
+#include "..\tiny_fs\external_sort.hpp"
+#include "..\tiny_fs\find.hpp"
+#include "..\tiny_fs\grep.hpp"
+#include "..\tiny_fs\atomic_write.hpp"
+#include "..\tiny_fs\apply_permissions.hpp"
+#include "..\tiny_fs\xattr.hpp"
+#include "..\tiny_fs\timestamps.hpp"
+#include "..\tiny_fs\volume.hpp"
+#include "..\tiny_fs\snapshot.hpp"
+#include "..\tiny_fs\directory_lookup.hpp"
+#include "..\tiny_fs\tempfile.hpp"
 
 #ifndef UNICODE
 #define UNICODE
@@ -37,6 +57,12 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <list>
 #include <deque>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <mutex>
+#include <set>
+#include <thread>
 
 namespace std
 {
@@ -130,4 +156,583 @@ TEST_CASE( "Testing tinydircpp::fs free functions", "Success and failures" )
             }
         }
     }
+    SECTION( "iterating directory_entry with metadata prefetch" )
+    {
+        std::deque<fs::directory_entry> const paths( fs::directory_iterator{ path_1 }, fs::directory_iterator{} );
+        std::deque<fs::directory_entry> const prefetched( fs::directory_iterator{ path_1, 2 },
+            fs::directory_iterator{} );
+        REQUIRE( paths.size() == prefetched.size() );
+        for ( std::size_t i = 0; i != paths.size(); ++i ) {
+            REQUIRE( paths[ i ].path().native() == prefetched[ i ].path().native() );
+            REQUIRE( fs::status_known( prefetched[ i ].status() ) );
+        }
+    }
+    SECTION( "scandir sorts and filters in one pass" )
+    {
+        auto const by_name = fs::scandir( path_1 );
+        std::deque<fs::directory_entry> const paths( fs::directory_iterator{ path_1 }, fs::directory_iterator{} );
+        REQUIRE( by_name.size() == paths.size() );
+        REQUIRE( std::is_sorted( by_name.begin(), by_name.end(),
+            []( fs::scandir_entry const & a, fs::scandir_entry const & b ) {
+            return std::wcscmp( a.name(), b.name() ) < 0;
+        } ) );
+
+        auto const by_inode = fs::scandir( path_1, fs::scandir_filter{}, fs::scandir_sort::inode );
+        REQUIRE( std::is_sorted( by_inode.begin(), by_inode.end(),
+            []( fs::scandir_entry const & a, fs::scandir_entry const & b ) { return a.inode() < b.inode(); } ) );
+
+        auto const directories = fs::scandir( path_1, []( fs::scandir_entry const & e ) { return e.is_dir(); } );
+        for ( auto const & entry : directories ) {
+            REQUIRE( fs::is_directory( entry.path() ) );
+        }
+
+        // a directory spelt with a trailing separator keeps the leading dot of its entries' names
+        path const dotted = fs::temporary_directory_path() / path{ "tinydircpp_scandir" };
+        fs::create_directories( dotted );
+        std::ofstream{ ( dotted / path{ ".hidden" } ).string() } << "x";
+        auto const hidden = fs::scandir( path{ dotted.native() + L"\\" } );
+        REQUIRE( hidden.size() == 1 );
+        REQUIRE( hidden.begin()->path().native() == dotted.native() + L"\\.hidden" );
+    }
+    SECTION( "instrumentation latency histogram" )
+    {
+        using fs::instrumentation::latency_histogram;
+        REQUIRE( latency_histogram::bucket_index( 31 ) == 31 );
+        REQUIRE( latency_histogram::bucket_lower_bound( latency_histogram::bucket_index( 1000 ) ) <= 1000 );
+        REQUIRE( latency_histogram::bucket_index( std::uint64_t( 1 ) << 50 ) == latency_histogram::bucket_count - 1 );
+
+        latency_histogram histogram{};
+        for ( std::uint64_t ns = 1; ns <= 100; ++ns ) histogram.record( ns );
+        REQUIRE( histogram.count() == 100 );
+        REQUIRE( histogram.percentile( 50 ) >= 48 );
+        REQUIRE( histogram.percentile( 50 ) <= 50 );
+        if ( !fs::instrumentation::enabled() ) {
+            REQUIRE( fs::instrumentation::collect().apis[ 0 ].calls == 0 );
+        }
+    }
+    SECTION( "status_cache answers like status and forgets on request" )
+    {
+        fs::status_cache cache{};
+        REQUIRE( cache.is_directory( path_1 ) == fs::is_directory( path_1 ) );
+        REQUIRE( cache.exists( path{ "C:\\this_should_not_exist" } ) == false );
+        REQUIRE( cache.size() == 2 );
+        REQUIRE( cache.exists( path{ "c:/users/" } ) ); // same entry, spelt differently
+        REQUIRE( cache.size() == 2 );
+        cache.invalidate( path_1 );
+        REQUIRE( cache.size() == 1 );
+        cache.clear();
+        REQUIRE( cache.size() == 0 );
+    }
+    SECTION( "asynchronous calls complete on the thread pool" )
+    {
+        fs::thread_pool_executor pool{ 2 };
+        auto is_directory = fs::async_status( pool, path_1 );
+        auto answer = fs::async_call( pool, [] { return 42; } );
+        auto missing = fs::async_read_file( pool, path{ "C:\\this_should_not_exist" } );
+        REQUIRE( fs::is_directory( is_directory.get() ) );
+        REQUIRE( answer.get() == 42 );
+        REQUIRE_THROWS_AS( missing.get(), fs::filesystem_error );
+    }
+    SECTION( "bulk create_directories creates each shared parent once" )
+    {
+        path const root = fs::temporary_directory_path() / path{ "tinydircpp_bulk" };
+        std::vector<path> const targets{ root / path{ "a\\b\\c" }, root / path{ "a/b/d" }, root / path{ "A\\e" },
+            root / path{ "f\\..\\g" } };
+        fs::create_directories( targets, 2 );
+        REQUIRE( fs::is_directory( root / path{ "a\\b\\c" } ) );
+        REQUIRE( fs::is_directory( root / path{ "a\\e" } ) );
+        REQUIRE( fs::is_directory( root / path{ "g" } ) );
+        REQUIRE_FALSE( fs::exists( root / path{ "f" } ) );
+        REQUIRE( fs::create_directories( targets ) == 0 );
+        std::ofstream{ ( root / path{ "file" } ).string() } << "not a directory";
+        REQUIRE_THROWS_AS( fs::create_directories( std::vector<path>{ root / path{ "file\\sub" } } ),
+            fs::filesystem_error );
+    }
+    SECTION( "listing a directory into an arena" )
+    {
+        fs::monotonic_arena arena{};
+        std::deque<fs::directory_entry> const paths( fs::directory_iterator{ path_1 }, fs::directory_iterator{} );
+        {
+            auto const listing = fs::list_directory( path_1, fs::arena_allocator<wchar_t>{ arena } );
+            REQUIRE( listing.size() == paths.size() );
+            for ( auto const & entry : listing ) {
+                REQUIRE( fs::exists( entry.path().to_path() ) );
+            }
+        }
+        REQUIRE( arena.bytes_reserved() > 0 );
+        arena.release();
+        auto const listing = fs::list_directory( path_1, std::allocator<wchar_t>{} );
+        REQUIRE( listing.size() == paths.size() );
+    }
+    SECTION( "path decomposition and component iteration" )
+    {
+        std::vector<std::wstring> parts{};
+        for ( auto const & component : cpp_file_path ) parts.push_back( component.wstring() );
+        std::vector<std::wstring> const expected{ L"C:", L"\\", L"Users", L"Josh", L"Desktop", L"push_back.cpp" };
+        REQUIRE( parts == expected );
+        REQUIRE( cpp_file_path.component_count() == 6 );
+        REQUIRE( cpp_file_path.filename().native() == L"push_back.cpp" );
+        REQUIRE( cpp_file_path.extension().native() == L".cpp" );
+        REQUIRE( cpp_file_path.stem().native() == L"push_back" );
+        REQUIRE( cpp_file_path.parent_path().native() == L"C:\\Users\\Josh\\Desktop" );
+        REQUIRE( cpp_file_path.root_name().native() == L"C:" );
+        REQUIRE( cpp_file_path.is_absolute() );
+        REQUIRE( rel_dir_path.is_relative() );
+        REQUIRE_FALSE( system_file_path.has_filename() );
+
+        path copy{ cpp_file_path };
+        copy /= path{ "x" };
+        REQUIRE( copy.filename_component() == fs::path_component( L"x", 1 ) );
+    }
+    SECTION( "normpath, relpath and realpath" )
+    {
+        REQUIRE( fs::normpath( path{ "C:/a/./b/../c//" } ).native() == L"C:\\a\\c" );
+        REQUIRE( fs::normpath( path{ "..\\..\\x" } ).native() == L"..\\..\\x" );
+        REQUIRE( fs::relpath( cpp_file_path, path_1 ).native() == L"Josh\\Desktop\\push_back.cpp" );
+        REQUIRE( fs::relpath( path_1, cpp_file_path ).native() == L"..\\..\\.." );
+        fs::relpath( path{ "D:\\x" }, path_1, ec );
+        REQUIRE( ec == std::errc::invalid_argument );
+
+        fs::path_resolver resolver{};
+        auto const resolved = resolver.realpath( symlink_path );
+        REQUIRE( fs::normpath( resolved ).native() == resolved.native() );
+        REQUIRE( resolver.size() != 0 );
+        REQUIRE( resolver.realpath( symlink_path ).native() == resolved.native() );
+        // spelt as on disk, not as whoever asked first
+        REQUIRE( resolver.realpath( path{ "c:\\users" } ).native() == L"C:\\Users" );
+    }
+    SECTION( "sync_tree copies what changed and nothing else" )
+    {
+        path const source = fs::temporary_directory_path() / path{ "tinydircpp_sync_source" };
+        path const destination = fs::temporary_directory_path() / path{ "tinydircpp_sync_destination" };
+        fs::create_directories( source / path{ "sub" } );
+        std::ofstream{ ( source / path{ "sub\\file.txt" } ).string() } << "synchronised";
+
+        fs::sync_options options{};
+        options.delete_extraneous = true;
+        auto const first = fs::sync_tree( source, destination, options );
+        REQUIRE( fs::file_size( destination / path{ "sub\\file.txt" } ) == 12 );
+        REQUIRE( first.files_copied + first.files_unchanged == 1 );
+
+        options.compare_contents = true;
+        auto const second = fs::sync_tree( source, destination, options );
+        REQUIRE( second.files_copied == 0 );
+        REQUIRE( second.files_unchanged == 1 );
+        REQUIRE( second.files_deleted == 0 );
+
+        // roots spelt with a trailing separator, dot-named entries keep their names on both sides
+        std::ofstream{ ( source / path{ ".dotted" } ).string() } << "dot";
+        auto const third = fs::sync_tree( path{ source.native() + L"\\" }, path{ destination.native() + L"\\" },
+            options );
+        REQUIRE( third.files_copied == 1 );
+        REQUIRE( fs::file_size( destination / path{ ".dotted" } ) == 3 );
+        REQUIRE_FALSE( fs::exists( destination / path{ "dotted" } ) );
+    }
+
+    SECTION( "streaming listings" )
+    {
+        std::stringstream stream{};
+        std::uint64_t written = 0;
+        {
+            fs::listing_writer writer{ stream, fs::listing_format::binary };
+            written = fs::write_listing( path_1, writer );
+            REQUIRE( writer.records_written() == written );
+        }
+        REQUIRE( written > 0 );
+
+        fs::binary_listing_reader reader{ stream };
+        fs::listing_record record{};
+        std::uint64_t read = 0;
+        while ( reader.next( record ) ) {
+            ++read;
+            REQUIRE( record.id == read );
+            REQUIRE( record.parent_id < record.id );
+        }
+        REQUIRE( read == written );
+
+        std::stringstream json{};
+        fs::listing_writer json_writer{ json, fs::listing_format::ndjson };
+        json_writer.write( 0, L"a\"b", 3, fs::file_type::regular, 12, 116444736000000000ULL );
+        json_writer.flush();
+        REQUIRE( json.str() == "{\"id\":1,\"parent\":0,\"name\":\"a\\\"b\",\"type\":\"regular\",\"size\":12,"
+            "\"mtime\":0.0000000}\n" );
+    }
+
+    SECTION( "external sort of listings" )
+    {
+        // a budget this small spills a run every few entries and needs several merge passes
+        fs::external_listing_sorter sorter{ 4096 };
+        std::vector<std::wstring> expected{};
+        for ( int i = 0; i != 2000; ++i ) {
+            expected.push_back( L"C:\\sorted\\" + std::to_wstring( ( i * 7919 ) % 2000 ) );
+            sorter.add( expected.back().data(), expected.back().size(), fs::file_type::regular, i, 0 );
+        }
+        std::sort( expected.begin(), expected.end() );
+        std::vector<std::wstring> sorted{};
+        sorter.merge( [&sorted]( fs::sorted_entry const & e ) { sorted.push_back( e.path ); } );
+        REQUIRE( sorter.runs_spilled() > 1 );
+        REQUIRE( sorted == expected );
+
+        std::vector<std::wstring> listing{};
+        auto const count = fs::sort_listing( path_1, [&listing]( fs::sorted_entry const & e ) {
+            listing.push_back( e.path );
+        }, 64 * 1024 );
+        REQUIRE( count == listing.size() );
+        REQUIRE( std::is_sorted( listing.begin(), listing.end() ) );
+    }
+
+    SECTION( "parallel find" )
+    {
+        fs::find_options options{};
+        options.max_depth = 1;
+        auto const children = fs::find( path_1, fs::find_predicate{}, options );
+        REQUIRE( children.size() == fs::scandir( path_1 ).size() );
+
+        auto const directories = fs::find( path_1, fs::type_is( fs::file_type::directory ), options );
+        auto const others = fs::find( path_1, !fs::type_is( fs::file_type::directory ), options );
+        REQUIRE( directories.size() + others.size() == children.size() );
+
+        options.max_depth = 2;
+        options.max_results = 1;
+        auto const linked = fs::hard_links_more_than( 0 ) && fs::type_is( fs::file_type::directory );
+        auto const first = fs::find( path_1, linked, options );
+        REQUIRE( first.size() == 1 );
+
+        REQUIRE( fs::find( path{ "C:\\this_should_not_exist" }, fs::find_predicate{}, options, ec ).empty() );
+        REQUIRE( ec );
+        ec.clear();
+    }
+
+    SECTION( "grep for literals" )
+    {
+        path const root = fs::temporary_directory_path() / path{ "tinydircpp_grep" };
+        fs::create_directories( root / path{ "sub" } );
+        std::ofstream{ ( root / path{ "a.txt" } ).string() } << "nothing here, token=SECRET";
+        std::ofstream{ ( root / path{ "sub\\b.txt" } ).string() } << "LICENSE first, SECRET second";
+
+        auto const hits = fs::grep( root, { "SECRET", "LICENSE" } );
+        REQUIRE( hits.size() == 3 );
+        REQUIRE( hits[ 0 ].offset == 20 );
+        REQUIRE( hits[ 0 ].literal == 0 );
+        REQUIRE( hits[ 1 ].offset == 0 );
+        REQUIRE( hits[ 1 ].literal == 1 );
+
+        fs::grep_options options{};
+        options.files = fs::name_matches( L"b.*" );
+        options.max_hits_per_file = 1;
+        REQUIRE( fs::grep( root, { "SECRET", "LICENSE" }, options ).size() == 1 );
+    }
+
+    SECTION( "atomic writes, rename and sync" )
+    {
+        path const root = fs::temporary_directory_path() / path{ "tinydircpp_atomic" };
+        fs::create_directories( root );
+        path const config = root / path{ "config.ini" };
+        fs::atomic_write( config, std::string{ "first" } );
+        auto const entries = fs::scandir( root ).size();
+        fs::atomic_write( config, std::string{ "second version" } );
+        REQUIRE( fs::file_size( config ) == 14 );
+        REQUIRE( fs::scandir( root ).size() == entries ); // no temporary left behind
+
+        fs::atomic_write_batch batch{};
+        for ( int i = 0; i != 8; ++i ) {
+            batch.add( root / path{ "checkpoint" + std::to_string( i ) }, std::string( i, 'x' ) );
+        }
+        batch.commit();
+        REQUIRE( batch.empty() );
+        REQUIRE( fs::file_size( root / path{ "checkpoint7" } ) == 7 );
+
+        fs::rename( root / path{ "checkpoint7" }, config );
+        REQUIRE( fs::file_size( config ) == 7 );
+        REQUIRE( !fs::exists( root / path{ "checkpoint7" } ) );
+        fs::sync( config );
+        fs::sync( root );
+
+        batch.add( root / path{ "missing\\checkpoint" }, "lost" );
+        batch.commit( ec );
+        REQUIRE( ec );
+        REQUIRE( batch.size() == 1 );
+        ec.clear();
+    }
+
+    SECTION( "file type masks and POSIX mode tables" )
+    {
+        static_assert( fs::is_regular_file( fs::status_from_mode( 0100644 ) ), "S_IFREG" );
+        static_assert( fs::is_other( fs::file_status{ fs::file_type::fifo } ), "a fifo is other" );
+        static_assert( !fs::exists( fs::file_status{ fs::file_type::not_found } ), "" );
+        static_assert( fs::status_known( fs::file_status{ fs::file_type::not_found } ), "" );
+        REQUIRE( fs::type_from_mode( 0040755 ) == fs::file_type::directory );
+        REQUIRE( fs::type_from_mode( 0120777 ) == fs::file_type::symlink );
+        REQUIRE( fs::type_from_mode( 0060660 ) == fs::file_type::block );
+        REQUIRE( fs::type_from_mode( 0020620 ) == fs::file_type::character );
+        REQUIRE( fs::type_from_mode( 0140755 ) == fs::file_type::socket );
+        REQUIRE( fs::type_from_dirent_type( 4 ) == fs::file_type::directory ); // DT_DIR
+        REQUIRE( fs::type_from_dirent_type( 0 ) == fs::file_type::none ); // DT_UNKNOWN
+        REQUIRE( fs::perms_from_mode( 0100644 ) == static_cast< fs::perms >( 0644 ) );
+
+        auto const link_or_file = fs::file_type_mask::regular | fs::file_type_mask::symlink;
+        REQUIRE( fs::status( cpp_file_path ).is( link_or_file ) );
+        REQUIRE( !fs::status( path_1 ).is( link_or_file ) );
+        REQUIRE( fs::status( path_1 ).permission() != fs::perms::none );
+        REQUIRE( !fs::is_socket( path_1 ) );
+    }
+
+    SECTION( "permissions and apply_permissions" )
+    {
+        path const root = fs::temporary_directory_path() / path{ "tinydircpp_permissions" };
+        fs::create_directories( root / path{ "sub" } );
+        path const file = root / path{ "sub\\file.txt" };
+        std::ofstream{ file.string() } << "read only soon";
+
+        fs::permissions( file, fs::perms::all );
+        fs::permissions( file, fs::perms::owner_write | fs::perms::group_write | fs::perms::others_write,
+            fs::permissions_status::remove_bits );
+        REQUIRE( fs::status( file ).permission() == static_cast< fs::perms >( 0555 ) );
+        fs::permissions( file, fs::perms::owner_write, fs::permissions_status::add_bits );
+        REQUIRE( fs::status( file ).permission() == fs::perms::all );
+        auto const follow = static_cast< fs::permissions_status >(
+            static_cast< int >( fs::permissions_status::remove_bits )
+            | static_cast< int >( fs::permissions_status::follow_symlinks ) );
+        fs::permissions( file, fs::perms::owner_write | fs::perms::group_write | fs::perms::others_write, follow );
+        REQUIRE( fs::status( file ).permission() == static_cast< fs::perms >( 0555 ) );
+        fs::permissions( file, fs::perms::all );
+
+        fs::permission_changes changes{};
+        changes.set_permissions = true;
+        changes.permissions = static_cast< fs::perms >( 0444 );
+        changes.include_root = false;
+        auto const first = fs::apply_permissions( root, changes );
+        REQUIRE( first.failed == 0 );
+        REQUIRE( fs::status( file ).permission() == static_cast< fs::perms >( 0555 ) );
+        auto const second = fs::apply_permissions( root, changes );
+        REQUIRE( second.changed == 0 );
+        REQUIRE( second.unchanged == first.changed + first.unchanged );
+
+        changes.permissions = fs::perms::all;
+        fs::apply_permissions( root, changes );
+        REQUIRE( fs::status( file ).permission() == fs::perms::all );
+
+        changes.how = follow;
+        fs::apply_permissions( root, changes, ec );
+        REQUIRE( ec == std::errc::invalid_argument );
+        ec.clear();
+        changes.how = fs::permissions_status::replace_bits;
+
+        changes.owner = L"not a SID";
+        fs::apply_permissions( root, changes, ec );
+        REQUIRE( ec );
+        ec.clear();
+    }
+
+    SECTION( "extended attributes as alternate data streams" )
+    {
+        path const root = fs::temporary_directory_path() / path{ "tinydircpp_xattr" };
+        fs::create_directories( root );
+        path const file = root / path{ "tagged.txt" };
+        std::ofstream{ file.string() } << "contents";
+
+        fs::set_xattrs( file, { { L"user.origin", "backup agent" }, { L"user.empty", "" } } );
+        auto const attributes = fs::get_xattrs( file );
+        REQUIRE( attributes.size() == 2 );
+        auto const origin = std::find_if( attributes.begin(), attributes.end(), []( fs::xattr const & a ) {
+            return a.name == L"user.origin";
+        } );
+        REQUIRE( origin != attributes.end() );
+        REQUIRE( origin->value == "backup agent" );
+        REQUIRE( fs::file_size( file ) == 8 ); // the file's own contents are untouched
+
+        std::size_t tagged = 0;
+        bool described = true;
+        auto const count = [&]( path const &, fs::xattr_list const & a, std::wstring const & sd ) {
+            tagged += !a.empty();
+            described = described && !sd.empty();
+        };
+        auto const visited = fs::walk_xattrs( root, count, true );
+        REQUIRE( visited >= 2 );
+        REQUIRE( tagged == 1 );
+        REQUIRE( described );
+
+        fs::set_xattrs( file, { { L"bad:name", "" } }, ec );
+        REQUIRE( ec );
+        ec.clear();
+    }
+
+    SECTION( "file times below a second" )
+    {
+        path const root = fs::temporary_directory_path() / path{ "tinydircpp_timestamps" };
+        fs::create_directories( root );
+        path const first = root / path{ "first.txt" }, second = root / path{ "second.txt" };
+        std::ofstream{ first.string() } << "1";
+        std::ofstream{ second.string() } << "2";
+
+        auto const original = fs::get_file_times( first );
+        fs::file_times times{};
+        times.last_write = fs::precise_file_time{ std::chrono::seconds{ 1500000000 } }
+            + std::chrono::nanoseconds{ 123456700 };
+        fs::set_file_times( first, times );
+        auto const updated = fs::get_file_times( first );
+        REQUIRE( updated.last_write == times.last_write );
+        REQUIRE( updated.creation == original.creation ); // omitted times are left alone
+        REQUIRE( fs::get_file_times( first, false ).last_write == times.last_write ); // no link to follow
+
+        times.creation = times.last_write - std::chrono::hours{ 1 };
+        auto const failures = fs::set_file_times( { { first, times }, { second, times },
+            { root / path{ "missing.txt" }, times } } );
+        REQUIRE( failures == 1 );
+        REQUIRE( fs::get_file_times( second ).creation == times.creation );
+
+        fs::set_file_times( root / path{ "missing.txt" }, times, ec );
+        REQUIRE( ec );
+        ec.clear();
+    }
+
+    SECTION( "volume capabilities and mount points" )
+    {
+        path const temporary = fs::temporary_directory_path();
+        auto const volume = fs::volume_of( temporary );
+        REQUIRE( !volume.file_system.empty() );
+        REQUIRE( volume.max_name_length > 0 );
+        REQUIRE( fs::volume_root( temporary ) == volume.root );
+        REQUIRE( fs::volume_of( temporary / path{ "not_there_yet.txt" } ).serial_number == volume.serial_number );
+
+        REQUIRE( fs::is_mount( volume.root ) );
+        REQUIRE( !fs::is_mount( temporary ) );
+        fs::forget_volumes();
+        REQUIRE( fs::volume_of( volume.root ).file_system == volume.file_system );
+    }
+
+    SECTION( "directory_iterator copies share one enumeration" )
+    {
+        std::deque<fs::directory_entry> const paths( fs::directory_iterator{ path_1 }, fs::directory_iterator{} );
+        fs::directory_iterator first{ path_1 };
+        fs::directory_iterator second = first;
+        REQUIRE( first == second );
+        if ( paths.size() > 1 ) {
+            ++second;
+            REQUIRE( first == second );
+            REQUIRE( ( *first ).path().native() == paths[ 1 ].path().native() );
+        }
+        while ( second != fs::directory_iterator{} ) ++second;
+        REQUIRE( first == fs::directory_iterator{} );
+
+        fs::directory_iterator shared{ path_1 };
+        std::mutex seen_mutex{};
+        std::set<std::wstring> seen{};
+        std::size_t handed_out = 0;
+        std::vector<std::thread> consumers{};
+        for ( int i = 0; i != 4; ++i ) {
+            consumers.emplace_back( [&, shared]() mutable { // Catch's REQUIRE isn't thread safe, check afterwards
+                std::vector<fs::directory_entry> chunk{};
+                while ( shared.split( chunk, 2 ) ) {
+                    std::lock_guard<std::mutex> lock{ seen_mutex };
+                    handed_out += chunk.size();
+                    for ( auto const & e : chunk ) seen.insert( e.path().native() );
+                }
+            } );
+        }
+        for ( auto & consumer : consumers ) consumer.join();
+        REQUIRE( handed_out == paths.size() );
+        REQUIRE( seen.size() == paths.size() );
+        REQUIRE( shared == fs::directory_iterator{} );
+    }
+
+    SECTION( "tree snapshot indexes hard links" )
+    {
+        path const root = fs::temporary_directory_path() / path{ "tinydircpp_snapshot" };
+        fs::create_directories( root / path{ "inner" } );
+        path const original = root / path{ "original.txt" };
+        path const sibling = root / path{ "sibling.txt" };
+        path const nested = root / path{ "inner" } / path{ "nested.txt" };
+        std::ofstream{ original.string() } << "shared";
+        fs::create_hard_link( original, sibling, ec ); // already there when the test runs again
+        fs::create_hard_link( original, nested, ec );
+        ec.clear();
+
+        fs::snapshot_options options{};
+        options.link_counts = true;
+        auto const snapshot = fs::snapshot_tree( root, options );
+        REQUIRE( snapshot.size() >= 5 );
+        REQUIRE( snapshot.equivalent( original, nested ) );
+        REQUIRE( !snapshot.equivalent( original, root / path{ "inner" } ) );
+        REQUIRE( snapshot.links_of( sibling ).size() == 3 );
+        auto const entry = snapshot.find( nested );
+        REQUIRE( entry != nullptr );
+        REQUIRE( entry->links_in_tree == 3 );
+        REQUIRE( entry->link_count == 3 );
+        REQUIRE( entry->size == 6 );
+        REQUIRE( snapshot.hard_link_groups().size() == 1 );
+        REQUIRE( snapshot.find( root / path{ "missing.txt" } ) == nullptr );
+
+        fs::snapshot_tree( root / path{ "missing" }, options, ec );
+        REQUIRE( ec );
+        ec.clear();
+    }
+
+    SECTION( "directory_lookup answers from a directory's names" )
+    {
+        path const root = fs::temporary_directory_path() / path{ "tinydircpp_lookup" };
+        fs::create_directories( root );
+        path const present = root / path{ "Present.txt" };
+        std::ofstream{ present.string() } << "here";
+        std::remove( ( root / path{ "later.txt" } ).string().c_str() );
+
+        fs::directory_lookup_options options{};
+        options.revalidate_after = std::chrono::milliseconds{ 0 }; // check the write time on every call
+        fs::directory_lookup lookup{ options };
+        REQUIRE( lookup.exists( present ) );
+        REQUIRE( lookup.contains( root, L"PRESENT.TXT" ) );
+        REQUIRE( !lookup.contains( root, L"absent.txt" ) );
+        REQUIRE( !lookup.contains( root / path{ "no_such_directory" }, L"anything" ) );
+        REQUIRE( lookup.size() == 2 );
+
+        std::ofstream{ ( root / path{ "later.txt" } ).string() } << "new";
+        REQUIRE( lookup.exists( root / path{ "later.txt" } ) );
+
+        REQUIRE( !fs::exists( root / path{ "absent.txt" }, ec ) );
+        REQUIRE( !ec ); // missing is an answer, not an error
+        lookup.clear();
+        REQUIRE( lookup.size() == 0 );
+    }
+
+    SECTION( "temporary files, directories and unique_path" )
+    {
+        path const model{ L"scratch-%%%%-%%%%.txt" };
+        path const first = fs::unique_path( model ), second = fs::unique_path( model );
+        REQUIRE( first.native().size() == model.native().size() );
+        REQUIRE( first.native().find( L'%' ) == std::wstring::npos );
+        REQUIRE( first.native() != second.native() );
+
+        path const directory = fs::create_temporary_directory( fs::temporary_directory_path(), L"tinydircpp-" );
+        REQUIRE( fs::is_directory( directory ) );
+        REQUIRE( directory.native() != fs::create_temporary_directory( fs::temporary_directory_path(),
+            L"tinydircpp-" ).native() );
+        // temporary_directory_path() ends with a separator, the dots have to survive it
+        REQUIRE( fs::create_temporary_directory( fs::temporary_directory_path(), L".tinydircpp-" ).filename_component()
+            .data()[ 0 ] == L'.' );
+        {
+            fs::temporary_file scratch{};
+            REQUIRE( scratch.path().filename_component().data()[ 0 ] == L'.' );
+        }
+
+        path scratch_path{};
+        {
+            fs::temporary_file scratch{ directory };
+            scratch.write( "thrown away" );
+            scratch_path = scratch.path();
+        }
+        REQUIRE( !fs::exists( scratch_path ) );
+
+        path const kept = directory / path{ "kept.txt" };
+        {
+            fs::temporary_file scratch{ directory };
+            scratch.write( "kept" );
+            scratch.keep_as( kept );
+            REQUIRE( scratch.kept() );
+        }
+        REQUIRE( fs::file_size( kept ) == 4 );
+
+        fs::create_temporary_directory( directory / path{ "missing" } / path{ "deeper" }, L"x", ec );
+        REQUIRE( ec );
+        ec.clear();
+    }
 }
\ No newline at end of file